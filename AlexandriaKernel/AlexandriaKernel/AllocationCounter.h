@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file AlexandriaKernel/AllocationCounter.h
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#ifndef _ALEXANDRIAKERNEL_ALLOCATIONCOUNTER_H
+#define _ALEXANDRIAKERNEL_ALLOCATIONCOUNTER_H
+
+#include <cstddef>
+
+namespace Euclid {
+
+/**
+ * @brief Returns the number of calls to the global operator new
+ *
+ * @details
+ * Only available to the programs linking the AlexandriaAllocationCounter
+ * library, which replaces the global operator new and operator delete with
+ * versions counting the allocations. It is meant for the benchmarks checking
+ * that a code path does not allocate, not for production code.
+ */
+size_t allocationCount();
+
+}  // namespace Euclid
+
+#endif  // _ALEXANDRIAKERNEL_ALLOCATIONCOUNTER_H
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file AlexandriaKernel/CancellationToken.h
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#ifndef _ALEXANDRIAKERNEL_CANCELLATIONTOKEN_H
+#define _ALEXANDRIAKERNEL_CANCELLATIONTOKEN_H
+
+#include <atomic>
+#include <memory>
+
+namespace Euclid {
+
+/**
+ * @class CancellationToken
+ *
+ * @brief A flag for cooperatively cancelling a set of tasks
+ *
+ * @details
+ * All the copies of a token share the same state, so a token can be captured
+ * by the tasks and cancelled from any thread. Cancelling does not interrupt
+ * anything by itself: the tasks which are already running have to poll
+ * isCancelled() and return early. The TaskGroup drops the tasks of a cancelled
+ * token which have not started yet.
+ */
+class CancellationToken {
+
+public:
+  /// Creates a new token, which is not cancelled
+  CancellationToken() : m_cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+  /// Requests the cancellation of the tasks using this token
+  void cancel() {
+    m_cancelled->store(true, std::memory_order_release);
+  }
+
+  /// Returns true if cancel() has been called on any copy of this token
+  bool isCancelled() const {
+    return m_cancelled->load(std::memory_order_acquire);
+  }
+
+private:
+  std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
+}  // namespace Euclid
+
+#endif  // _ALEXANDRIAKERNEL_CANCELLATIONTOKEN_H
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file AlexandriaKernel/Coroutine.h
+ * @date 16/10/26
+ * @author nikoapos
+ *
+ * @brief C++20 coroutine support for the ThreadPool
+ *
+ * @details
+ * This file is empty unless the compiler supports coroutines, in which case
+ * ALEXANDRIA_HAVE_COROUTINES is defined. It provides:
+ * - Coroutine<T>, a lazily started coroutine returning a T, which can be
+ *   awaited by other coroutines
+ * - sync_wait(), which blocks a normal thread until a coroutine finishes
+ * - when_all(), which runs a set of coroutines concurrently
+ * - IoLane, which runs blocking calls (like reading a file) on dedicated
+ *   threads, so they do not occupy the workers of the pool
+ *
+ * Together with ThreadPool::schedule() they allow writing pipelines which
+ * overlap the I/O with the computations as straight-line code:
+ *
+ * @code
+ * Coroutine<double> processChunk(ThreadPool& pool, IoLane& io, Reader& reader) {
+ *   auto chunk = co_await io.run([&reader]() { return reader.read(1000); });
+ *   co_await pool.schedule();
+ *   co_return fit(chunk);
+ * }
+ * @endcode
+ */
+
+#ifndef _ALEXANDRIAKERNEL_COROUTINE_H
+#define _ALEXANDRIAKERNEL_COROUTINE_H
+
+#include "AlexandriaKernel/ThreadPool.h"
+
+#ifdef ALEXANDRIA_HAVE_COROUTINES
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+namespace Euclid {
+
+namespace Coroutine_Impl {
+
+template <typename T>
+class Promise;
+
+template <typename T>
+struct Result;
+
+template <typename F>
+class IoAwaitable;
+
+}  // namespace Coroutine_Impl
+
+/**
+ * @class Coroutine
+ *
+ * @brief A coroutine returning a value of type T
+ *
+ * @details
+ * The coroutine does not start when it is called, but when it is awaited (or
+ * passed to sync_wait() or when_all()), and it runs on the thread awaiting it
+ * until it suspends, for example by awaiting ThreadPool::schedule(). When it
+ * finishes, the awaiting coroutine continues on the same thread. Any exception
+ * thrown by the coroutine is rethrown to the awaiting one. The object owns
+ * the coroutine frame, so it must outlive its execution.
+ */
+template <typename T = void>
+class Coroutine {
+
+public:
+  class promise_type;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  Coroutine(Coroutine&& other) noexcept;
+
+  Coroutine& operator=(Coroutine&& other) noexcept;
+
+  Coroutine(const Coroutine&) = delete;
+
+  Coroutine& operator=(const Coroutine&) = delete;
+
+  ~Coroutine();
+
+  /// Returns true if the coroutine has finished
+  bool done() const noexcept;
+
+  bool await_ready() const noexcept;
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept;
+
+  T await_resume();
+
+private:
+  explicit Coroutine(handle_type handle);
+
+  handle_type m_handle;
+};
+
+/**
+ * @brief Runs a coroutine and blocks the calling thread until it finishes
+ * @return
+ *    The value returned by the coroutine. If it threw, the exception is rethrown.
+ * @note
+ *    Do not call it from a worker of a pool the coroutine needs for making
+ *    progress, as it blocks the worker.
+ */
+template <typename T>
+T sync_wait(Coroutine<T> coroutine);
+
+/**
+ * @brief Runs a set of coroutines concurrently
+ * @details
+ * The coroutines are started one after the other on the awaiting thread. Each
+ * one runs until it first suspends, so for running them in parallel they
+ * should start by awaiting ThreadPool::schedule(). The awaiting coroutine
+ * continues when all of them have finished, on the thread which finished last.
+ * @return
+ *    The values returned by the coroutines, in the same order. If any of them
+ *    threw, the first exception (in the same order) is rethrown.
+ */
+template <typename T>
+Coroutine<std::vector<T>> when_all(std::vector<Coroutine<T>> coroutines);
+
+/// Runs a set of coroutines which return nothing concurrently
+Coroutine<void> when_all(std::vector<Coroutine<void>> coroutines);
+
+/**
+ * @class IoLane
+ *
+ * @brief Runs blocking calls on dedicated threads and resumes the awaiting
+ * coroutines on a ThreadPool
+ *
+ * @details
+ * `co_await lane.run(func)` suspends the coroutine, calls func on one of the
+ * threads of the lane and then resumes the coroutine on a worker of the pool,
+ * with high priority, getting the value returned by func (or the exception it
+ * threw). This way the workers of the pool never block on I/O. Calls still
+ * pending when the lane is destroyed are discarded and their coroutines are
+ * never resumed.
+ */
+class IoLane {
+
+public:
+  /**
+   * @brief Constructs a new IoLane
+   * @param pool
+   *    The pool the coroutines continue on after the blocking calls
+   * @param thread_count
+   *    The number of threads executing the blocking calls
+   */
+  explicit IoLane(ThreadPool& pool, unsigned int thread_count = 1);
+
+  /// Returns an awaitable which calls func on the lane and returns its result
+  template <typename F>
+  Coroutine_Impl::IoAwaitable<typename std::decay<F>::type> run(F&& func);
+
+private:
+  ThreadPool& m_pool;
+  ThreadPool  m_io;
+};
+
+}  // namespace Euclid
+
+#include "AlexandriaKernel/_impl/Coroutine.icpp"
+
+#endif  // ALEXANDRIA_HAVE_COROUTINES
+
+#endif  // _ALEXANDRIAKERNEL_COROUTINE_H
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file AlexandriaKernel/Numa.h
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#ifndef _ALEXANDRIAKERNEL_NUMA_H
+#define _ALEXANDRIAKERNEL_NUMA_H
+
+#include <vector>
+
+namespace Euclid {
+namespace Numa {
+
+/**
+ * @brief Returns true if the NUMA topology of the machine can be queried
+ * @details
+ * This is the case when Alexandria has been built with libnuma and the
+ * kernel supports NUMA. Otherwise all the CPUs and all the memory are
+ * reported as belonging to node zero.
+ */
+bool available();
+
+/// Returns the number of NUMA nodes of the machine
+int nodeCount();
+
+/// Returns the NUMA node of a CPU
+int nodeOfCpu(unsigned int cpu);
+
+/**
+ * @brief Returns the NUMA node of the memory page containing an address
+ * @return
+ *    The node, or -1 if it is not known (for example because the page has
+ *    never been touched or NUMA is not available)
+ */
+int nodeOfAddress(const void* address);
+
+/// Returns the CPUs the calling process is allowed to run on, in increasing order
+std::vector<unsigned int> allowedCpus();
+
+/**
+ * @brief Binds the calling thread to a single CPU
+ * @return
+ *    True on success, false if the platform does not support it or the CPU
+ *    is not available
+ */
+bool pinCurrentThread(unsigned int cpu);
+
+}  // namespace Numa
+}  // namespace Euclid
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file AlexandriaKernel/Parallel.h
+ * @date 16/10/26
+ * @author nikoapos
+ *
+ * @brief Parallel loop primitives executed by a ThreadPool
+ *
+ * @details
+ * The functions of this file split a range in chunks, which are executed as the
+ * tasks of a TaskGroup. The range can be given either by a pair of (at least
+ * forward) iterators, like the ones of the STL containers, the GridContainer or
+ * the NdArray, or by a pair of integral indices. In the second case the body
+ * gets the index instead of the dereferenced element.
+ *
+ * The grain is the minimum number of elements per chunk. If it is zero, the
+ * chunks are sized automatically, so each thread of the pool gets a few of them.
+ * The functions block until all the chunks are done and, if any of the chunks
+ * throws, they rethrow the first exception (like TaskGroup::block() does). They
+ * can be called from inside tasks running on the same pool.
+ *
+ * If the pool has NUMA local queues (see ThreadPool::numaNodes()), each chunk
+ * of an iterator range is queued for the node its first element is stored on.
+ * Chunks of an index range are assigned to the nodes in order, so consecutive
+ * loops over the same indices process each chunk on the same node, which is
+ * the one that touched its memory first.
+ */
+
+#ifndef _ALEXANDRIAKERNEL_PARALLEL_H
+#define _ALEXANDRIAKERNEL_PARALLEL_H
+
+#include "AlexandriaKernel/TaskGroup.h"
+#include "AlexandriaKernel/ThreadPool.h"
+#include <cstddef>
+
+namespace Euclid {
+
+/**
+ * Apply the body to every element of the range [first, last)
+ * @param pool
+ *    The pool executing the chunks
+ * @param first
+ *    The beginning of the range
+ * @param last
+ *    The end of the range
+ * @param grain
+ *    Minimum number of elements per chunk, or zero for automatic chunking
+ * @param body
+ *    Called with a reference to each element (or with each index for integral ranges)
+ */
+template <typename Iterator, typename Body>
+void parallel_for(ThreadPool& pool, Iterator first, Iterator last, std::size_t grain, Body body);
+
+/**
+ * Reduce the range [first, last) to a single value
+ * @details
+ * Each chunk starts from the identity and folds its elements with accumulate,
+ * so every chunk works on its own accumulator. The chunk results are then
+ * combined sequentially, in the order of the chunks. The chunking only depends
+ * on the range size, the grain and the number of threads, so for a given pool
+ * the result is deterministic even for non associative operations like floating
+ * point additions.
+ * @param identity
+ *    The initial value of every accumulator
+ * @param accumulate
+ *    Called as accumulate(accumulator, element) and returns the new accumulator
+ * @param combine
+ *    Called as combine(a, b) to merge the accumulators of two consecutive chunks
+ * @return
+ *    The combination of all the chunk accumulators (identity for an empty range)
+ */
+template <typename Iterator, typename T, typename Accumulate, typename Combine>
+T parallel_reduce(ThreadPool& pool, Iterator first, Iterator last, std::size_t grain, T identity, Accumulate accumulate,
+                  Combine combine);
+
+/**
+ * Store the result of the function applied to each element of [first, last) to
+ * the range starting at out
+ * @param out
+ *    The beginning of the output range, which must be at least a forward iterator
+ *    and have space for all the results
+ * @param func
+ *    Called with each element (or index)
+ * @return
+ *    The end of the output range
+ */
+template <typename Iterator, typename OutputIterator, typename Function>
+OutputIterator parallel_transform(ThreadPool& pool, Iterator first, Iterator last, OutputIterator out, std::size_t grain,
+                                  Function func);
+
+}  // namespace Euclid
+
+#include "AlexandriaKernel/_impl/Parallel.icpp"
+
+#endif  // _ALEXANDRIAKERNEL_PARALLEL_H
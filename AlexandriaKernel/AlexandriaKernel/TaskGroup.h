@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file AlexandriaKernel/TaskGroup.h
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#ifndef _ALEXANDRIAKERNEL_TASKGROUP_H
+#define _ALEXANDRIAKERNEL_TASKGROUP_H
+
+#include "AlexandriaKernel/CancellationToken.h"
+#include "AlexandriaKernel/ThreadPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+namespace Euclid {
+
+/**
+ * @class TaskGroup
+ *
+ * @brief A set of tasks executed by a ThreadPool, which can be waited for independently
+ *
+ * @details
+ * The tasks submitted via the TaskGroup::submit() method are executed by the
+ * workers of the pool, together with any other tasks the pool has. The
+ * TaskGroup::block() method waits only for the tasks of the group, and it is
+ * allowed to submit more tasks to the group (or to the pool) while waiting,
+ * for example from the tasks of the group themselves.
+ *
+ * When block() is called from inside a task running on the same pool, the
+ * blocked worker executes queued tasks of the pool instead of sleeping. This
+ * makes it safe to nest groups recursively without exhausting the workers.
+ * Note that the worker may pick tasks which do not belong to the group.
+ *
+ * If any of the tasks of the group throws an exception, it is captured by the
+ * group and rethrown by block(). It does not put the pool in an exception state,
+ * so the other users of the pool are not affected.
+ *
+ * Every group has a CancellationToken. After cancel() is called, the tasks of
+ * the group which have not started yet are dropped without running, while the
+ * running ones can poll the token (captured via token()) and return early. A
+ * token can also be shared by several groups, by passing it to the constructor.
+ * Tasks discarded by ThreadPool::cancelAll() are counted as finished as well,
+ * so block() never waits for them.
+ *
+ * The TaskGroup must not outlive the pool and the destructor waits for the
+ * tasks of the group to finish, ignoring any exceptions.
+ */
+class TaskGroup {
+
+public:
+  /**
+   * @brief Constructs a new, empty, TaskGroup
+   * @param pool
+   *    The pool which will execute the tasks
+   */
+  explicit TaskGroup(ThreadPool& pool);
+
+  /**
+   * @brief Constructs a new, empty, TaskGroup, which uses an existing token
+   * @param pool
+   *    The pool which will execute the tasks
+   * @param token
+   *    The token cancelling the tasks of the group
+   */
+  TaskGroup(ThreadPool& pool, CancellationToken token);
+
+  /// Waits for the tasks of the group to finish
+  virtual ~TaskGroup();
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  /// Submit a task to be executed as part of the group. The task can be any callable
+  /// which gets no parameters and returns void.
+  template <typename F>
+  void submit(F&& func);
+
+  /// Submit a task to be executed as part of the group, preferably by a worker
+  /// of the given NUMA node (see ThreadPool::submitToNode())
+  template <typename F>
+  void submitToNode(F&& func, int node);
+
+  /// Submit a task to be executed as part of the group with the given priority
+  template <typename F>
+  void submit(F&& func, ThreadPool::Priority priority);
+
+  /// Cancels the tasks of the group. The ones which have not started are dropped.
+  void cancel();
+
+  /// Returns true if the group has been cancelled
+  bool isCancelled() const;
+
+  /// Returns the token of the group, which the running tasks can poll
+  const CancellationToken& token() const;
+
+  /// Blocks the calling thread until all the tasks of the group are finished and
+  /// rethrows the first exception thrown by any of them
+  void block();
+
+  /// Checks if any task of the group has thrown an exception and optionally rethrows it
+  bool checkForException(bool rethrow = false);
+
+  /// Return the number of tasks of the group which are not finished yet
+  size_t pending() const;
+
+private:
+  /// The state shared between the group and its tasks, which may outlive the group object
+  struct State {
+    explicit State(ThreadPool& thread_pool) : pool(thread_pool) {}
+
+    ThreadPool&             pool;
+    std::atomic<size_t>     pending{0};
+    std::mutex              mutex;
+    std::condition_variable done_cv;
+    std::exception_ptr      exception_ptr;
+    CancellationToken       token;
+
+    /// Keeps the exception, unless another task has already failed
+    void fail(std::exception_ptr exception);
+
+    /// Marks a task as finished, waking up the waiting threads if it was the last one.
+    /// The threads which can not help the pool wait on its idle condition instead of
+    /// done_cv, so they also wake up if the pool fails.
+    void finish();
+  };
+
+  /// Wraps the submitted callables, so they report their state to the group
+  template <typename F>
+  struct GroupTask {
+    template <typename G>
+    GroupTask(std::shared_ptr<State> group_state, G&& group_func)
+        : state(std::move(group_state)), func(std::forward<G>(group_func)) {}
+
+    GroupTask(GroupTask&&) = default;
+    GroupTask& operator=(GroupTask&&) = delete;
+
+    /// A task destroyed without running (for example by ThreadPool::cancelAll())
+    /// still has to be reported as finished
+    ~GroupTask() {
+      if (state) {
+        state->finish();
+      }
+    }
+
+    void operator()() {
+      auto finished = std::move(state);
+      if (!finished->token.isCancelled()) {
+        try {
+          func();
+        } catch (...) {
+          finished->fail(std::current_exception());
+        }
+      }
+      finished->finish();
+    }
+
+    std::shared_ptr<State> state;
+    F                      func;
+  };
+
+  ThreadPool&            m_pool;
+  std::shared_ptr<State> m_state;
+};
+
+template <typename F>
+void TaskGroup::submit(F&& func) {
+  ++m_state->pending;
+  m_pool.submit(GroupTask<typename std::decay<F>::type>{m_state, std::forward<F>(func)});
+}
+
+template <typename F>
+void TaskGroup::submitToNode(F&& func, int node) {
+  ++m_state->pending;
+  m_pool.submitToNode(GroupTask<typename std::decay<F>::type>{m_state, std::forward<F>(func)}, node);
+}
+
+template <typename F>
+void TaskGroup::submit(F&& func, ThreadPool::Priority priority) {
+  ++m_state->pending;
+  m_pool.submit(GroupTask<typename std::decay<F>::type>{m_state, std::forward<F>(func)}, priority);
+}
+
+}  // namespace Euclid
+
+#endif  // _ALEXANDRIAKERNEL_TASKGROUP_H
@@ -25,14 +25,30 @@
 #ifndef _ALEXANDRIAKERNEL_THREADPOOL_H
 #define _ALEXANDRIAKERNEL_THREADPOOL_H
 
+#include <array>
 #include <atomic>
-#include <deque>
+#include <chrono>
+#include <condition_variable>
 #include <exception>
 #include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+#include "AlexandriaKernel/ThreadPoolStatistics.h"
+#include "AlexandriaKernel/UniqueTask.h"
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+/// Defined when the compiler supports C++20 coroutines (see AlexandriaKernel/Coroutine.h)
+#define ALEXANDRIA_HAVE_COROUTINES 1
+#endif
+#endif
+
 namespace Euclid {
 
 /**
@@ -49,28 +65,166 @@ namespace Euclid {
  * Using the pool is quite simple. The constructor of the ThreadPool gets as
  * parameter the number of threads that will be spawned (defaults to the number
  * of threads available). The ThreadPool::submit() method can be used to submit
- * tasks to the thread pool queue. Tasks can be anything that can be assigned
- * to a std::function object which does not get any parameters and returns void.
+ * tasks to the thread pool queue. Tasks can be any callable which does not get
+ * any parameters. The pool stores them internally as UniqueTask objects, so
+ * they are moved (never copied) through the queue and, if they are small
+ * enough, submitting and running them does not allocate any memory.
  * The thread pool will assign all tasks to the threads to be executed at the
  * same order as they are submitted. To block until all the tasks in the pool
  * have been executed, one can all the ThreadPool::block() method.
  *
  * Note that when the ThreadPool object goes out of scope and its destructor is
  * called it will not process any tasks that are not already started, but it will
- * block until all threads finish with the currently executing tasks.
+ * block until all threads finish with the currently executing tasks. The same
+ * discarding of the tasks not yet started can be done explicitly with
+ * cancelAll(), which keeps the pool usable.
  *
  * If any of the tasks in the queue throws an exception, all other running tasks
  * will finish their execution, but no new tasks will be started. In this case,
  * the block() method will rethrow the exception. The pool can be checked if it
  * is in an exception state by calling the checkForException() method.
  *
+ * By default the idle threads poll the queue, sleeping for a fixed amount of
+ * time between the retries. This adds up to that amount of latency before a
+ * submitted task is started. If the pool is constructed with
+ * Options::event_driven set, the idle threads instead block on a condition
+ * variable and are woken up by submit(), so tasks start immediately and idle
+ * threads do not consume any CPU. The block() method always returns as soon as
+ * the last task finishes.
+ *
+ * By default all the workers get their tasks from a single queue. With many
+ * threads and short tasks the lock of this queue becomes a bottleneck. If the
+ * pool is constructed with Options::scheduling set to Scheduling::WorkStealing,
+ * each worker owns its own queue instead. Tasks submitted from outside the pool
+ * are distributed over the workers in a round robin fashion, while tasks
+ * submitted from inside a running task go to the queue of the worker running
+ * it. Workers execute their own tasks in LIFO order (the most recently
+ * submitted first) and, when they run out of work, they steal the oldest tasks
+ * from the queues of the other workers. In this mode tasks are not guaranteed
+ * to start in the order they were submitted.
+ *
+ * Tasks which return a value can be submitted with submitWithResult(), which
+ * returns a std::future for the result. Any exception thrown
+ * by such a task is stored in the future and does not put the pool in an
+ * exception state. To wait only for a subset of the tasks, without blocking
+ * the whole pool, use a TaskGroup.
+ *
+ * By default the queue is unbounded. When the tasks are produced faster than
+ * they are consumed (for example when reading a big catalog) this can use an
+ * unlimited amount of memory. Setting Options::queue_capacity limits the number
+ * of queued tasks. When the queue is full, submit() blocks the producer until
+ * a worker picks up a task, while trySubmit() returns false immediately. To
+ * avoid deadlocks, a task submitted by a worker of the pool while the queue is
+ * full is executed directly by the submitting worker. The queuedHighWaterMark()
+ * and runningHighWaterMark() methods can be used to monitor the pool.
+ *
+ * The statistics() method returns a snapshot of the counters the workers keep
+ * (executed and stolen tasks per worker), which can be converted to JSON. If
+ * Options::collect_timings is set, the workers also measure the time they spend
+ * executing tasks, and the snapshot contains histograms of the time the tasks
+ * waited in the queue and of their duration. This costs a few clock readings
+ * per task, so it is disabled by default.
+ *
+ * By default the workers are not bound to any CPU. With Options::cores or
+ * Options::affinity each worker is pinned to a single CPU, so it keeps using
+ * the same caches and the same NUMA node. If in addition
+ * Options::numa_local_queues is set and the workers span more than one NUMA
+ * node, the tasks are queued per node: idle workers first look for tasks of
+ * their own node and only then take the tasks of the other nodes. The
+ * submitToNode() method queues a task for the workers of a specific node,
+ * which is what the parallel_for() family of functions uses for processing
+ * the data on the node it has been allocated on. The NUMA topology is only
+ * known if Alexandria has been built with libnuma; otherwise the pinning
+ * still works, but all the CPUs are treated as a single node.
+ *
+ * Tasks can be submitted with a Priority. A worker always picks a queued task
+ * of the highest priority available, so latency sensitive tasks (like reading
+ * the next chunk of a catalog) are not stuck behind bulk work. Tasks of the
+ * same priority keep the order described above. To cancel a subset of the
+ * tasks, submit them through a TaskGroup and use its CancellationToken.
+ *
+ * When the compiler supports C++20 coroutines, a coroutine can move itself to
+ * a worker of the pool with `co_await pool.schedule()`. See
+ * AlexandriaKernel/Coroutine.h for the rest of the coroutine support.
+ *
  */
+namespace ThreadPool_Impl {
+
+/// The type returned by calling F without parameters
+#if __cplusplus >= 201703L
+template <typename F>
+using ResultOf = std::invoke_result_t<F>;
+#else
+template <typename F>
+using ResultOf = typename std::result_of<F()>::type;
+#endif
+
+}  // namespace ThreadPool_Impl
+
 class ThreadPool {
 
 public:
   /// The type of tasks the pool can execute
   using Task = std::function<void(void)>;
 
+  /// The way the tasks are distributed to the workers
+  enum class Scheduling {
+    /// All workers share a single FIFO queue
+    Shared,
+    /// Each worker has its own queue and steals from the others when it is empty
+    WorkStealing
+  };
+
+  /// The way the workers are bound to CPUs
+  enum class Affinity {
+    /// The workers are not bound, the operating system moves them freely
+    None,
+    /// Consecutive workers get consecutive CPUs, filling a NUMA node before moving to the next
+    Compact,
+    /// Consecutive workers get CPUs of different NUMA nodes, in a round robin fashion
+    Scatter
+  };
+
+  /// The priority of a task. Queued tasks of higher priority are started first.
+  enum class Priority { Low, Normal, High };
+
+  /// The number of priority levels
+  static constexpr size_t PRIORITY_COUNT = 3;
+
+  /**
+   * @struct Options
+   * @brief Parameters controlling the behaviour of the ThreadPool
+   */
+  struct Options {
+    /// The number of threads in the pool
+    unsigned int thread_count = std::thread::hardware_concurrency();
+    /// The time (in milliseconds) the pool threads sleep after they try to get
+    /// a task from an empty queue before they retry. Ignored in event driven mode.
+    unsigned int empty_queue_wait_time = 50;
+    /// If true the idle threads block until a task is submitted, instead of
+    /// polling the queue
+    bool event_driven = false;
+    /// How the tasks are distributed to the workers
+    Scheduling scheduling = Scheduling::Shared;
+    /// The maximum number of queued tasks, or zero for an unbounded queue
+    size_t queue_capacity = 0;
+    /// If true the workers measure the queue wait time and the duration of the
+    /// tasks, which are reported by statistics()
+    bool collect_timings = false;
+    /// How the workers are bound to the CPUs the process is allowed to run on.
+    /// Ignored if the cores are given explicitly.
+    Affinity affinity = Affinity::None;
+    /// The CPUs the workers are bound to. The worker i is bound to the CPU
+    /// cores[i % cores.size()]. If empty, the affinity policy is used.
+    std::vector<unsigned int> cores;
+    /// If true, and the workers are bound to CPUs of more than one NUMA node,
+    /// the tasks are queued separately for each node
+    bool numa_local_queues = false;
+  };
+
+  /// A snapshot of the statistics of the pool
+  using Statistics = ThreadPoolStatistics;
+
   /**
    * @brief Constructs a new ThreadPool
    * @param thread_count
@@ -81,12 +235,56 @@ public:
    */
   explicit ThreadPool(unsigned int thread_count = std::thread::hardware_concurrency(), unsigned int empty_queue_wait_time = 50);
 
+  /**
+   * @brief Constructs a new ThreadPool
+   * @param options
+   *    The parameters of the pool
+   */
+  explicit ThreadPool(const Options& options);
+
   /// All tasks not yet started are discarded and it blocks until all already
   /// executing tasks are finished
   virtual ~ThreadPool();
 
-  /// Submit a task to be executed
-  void submit(Task task);
+  /// Submit a task to be executed. If the queue is full, it blocks until there is space.
+  void submit(UniqueTask task);
+
+  /// Submit a task to be executed with the given priority
+  void submit(UniqueTask task, Priority priority);
+
+  /**
+   * @brief Submit a task to be executed preferably by a worker of a NUMA node
+   * @param task
+   *    The task to execute
+   * @param node
+   *    The NUMA node. If it is negative or the pool has no queue for it (see
+   *    numaNodes()), this is the same as calling submit().
+   */
+  void submitToNode(UniqueTask task, int node);
+
+  /**
+   * @brief Submit a task to be executed, if there is space in the queue
+   * @param func
+   *    The callable to execute, which gets no parameters
+   * @return
+   *    True if the task has been submitted. If the queue was full, it returns
+   *    false and func is left untouched, so the caller can retry later.
+   */
+  template <typename F>
+  bool trySubmit(F&& func);
+
+  /**
+   * @brief Submit a task which returns a value
+   * @param func
+   *    The callable to execute, which gets no parameters
+   * @return
+   *    A future which will get the value returned by func, or the exception it threw
+   * @note
+   *    Calling get() on the future from inside a task of the same pool blocks
+   *    the worker. Use a TaskGroup for waiting from inside the pool.
+   */
+  template <typename F, typename R = ThreadPool_Impl::ResultOf<F>>
+  std::future<R> submitWithResult(F&& func);
 
   /// Blocks the calling thread until all the tasks in the pool queue are finished.
   /// Note that submitting tasks until this method returns is not allowed.
@@ -95,6 +293,19 @@ public:
   /// Checks if any task has thrown an exception and optionally rethrows it
   bool checkForException(bool rethrow = false);
 
+  /**
+   * @brief Discards all the tasks which have not started yet
+   * @details
+   * The tasks already running are not affected. The discarded tasks are
+   * destroyed without being executed, so the futures of the tasks submitted
+   * with submitWithResult() get a std::future_error (broken promise) and
+   * the TaskGroups stop waiting for them. The pool can be used normally after
+   * this call.
+   * @return
+   *    The number of discarded tasks
+   */
+  size_t cancelAll();
+
   /// Return the number of queued tasks
   size_t queued() const;
 
@@ -104,18 +315,102 @@ public:
   /// Return the number of active workers (either running or sleeping)
   size_t activeThreads() const;
 
+  /// Return the maximum number of tasks the queue can hold, or zero if it is unbounded
+  size_t queueCapacity() const;
+
+  /// Return the maximum number of tasks which have been queued at the same time
+  size_t queuedHighWaterMark() const;
+
+  /// Return the maximum number of tasks which have been running at the same time
+  size_t runningHighWaterMark() const;
+
+  /// Return a snapshot of the statistics of the pool. It can be called at any
+  /// time, while the tasks are running.
+  Statistics statistics() const;
+
+  /// Return the NUMA nodes which have their own queues, in increasing order.
+  /// It is empty if the queues are not NUMA local.
+  const std::vector<int>& numaNodes() const;
+
+#ifdef ALEXANDRIA_HAVE_COROUTINES
+  class ScheduleAwaitable;
+
+  /**
+   * @brief Returns an awaitable which moves the awaiting coroutine to the pool
+   * @details
+   * `co_await pool.schedule()` suspends the coroutine and submits its
+   * continuation as a task, so everything after it runs on a worker of the
+   * pool. If the task is discarded (by cancelAll() or the destructor) the
+   * coroutine is never resumed.
+   */
+  ScheduleAwaitable schedule(Priority priority = Priority::Normal);
+#endif
+
 private:
-  mutable std::mutex             m_queue_mutex;
-  std::vector<std::atomic<bool>> m_worker_run_flags;
-  std::vector<std::atomic<bool>> m_worker_sleeping_flags;
-  std::vector<std::atomic<bool>> m_worker_done_flags;
-  std::vector<std::thread>       m_workers;
-  std::deque<Task>               m_queue;
-  unsigned int                   m_empty_queue_wait_time;
-  std::exception_ptr             m_exception_ptr;
+  friend class TaskGroup;
+  class Worker;
+  struct TaskQueue;
+  struct QueuedTask;
+  struct WorkerCounters;
+
+  /// Accounts for a new task in the queue, returns false if the queue is full
+  bool tryReserveSlot();
+
+  /// Submits a task to the queues of the given node with the given priority
+  void submitTask(UniqueTask task, int node, Priority priority);
+
+  /// Puts a task in the queue, for which tryReserveSlot() has already succeeded
+  void enqueue(UniqueTask task, int node = -1, Priority priority = Priority::Normal);
+
+  /// Moves the next task the given worker should run to entry, returns false if
+  /// there is none. Sets stolen if the task comes from the queue of another worker.
+  bool popTask(size_t worker_index, QueuedTask& entry, bool& stolen);
+
+  /// Runs a task that has been popped from the queues, keeping track of its state
+  void runTask(QueuedTask& entry, bool stolen);
+
+  /// Runs one of the queued tasks in the calling thread, returns false if there is none
+  bool tryRunPendingTask();
+
+  /// Returns true if the calling thread is one of the workers of this pool
+  bool isWorkerThread() const;
+
+  /// Wakes up the threads waiting on m_idle_cv, so they check their condition again
+  void notifyIdle();
+
+  Options                                         m_options;
+  mutable std::mutex                              m_queue_mutex;
+  std::condition_variable                         m_queue_cv;
+  std::condition_variable                         m_idle_cv;
+  std::condition_variable                         m_space_cv;
+  std::vector<std::atomic<bool>>                  m_worker_run_flags;
+  std::vector<std::atomic<bool>>                  m_worker_done_flags;
+  std::vector<std::thread>                        m_workers;
+  std::vector<std::unique_ptr<TaskQueue>>         m_queues;
+  std::vector<std::unique_ptr<WorkerCounters>>    m_counters;
+  std::vector<int>                                m_worker_cpus;
+  std::vector<int>                                m_numa_nodes;
+  std::vector<size_t>                             m_worker_queues;
+  std::vector<size_t>                             m_queue_nodes;
+  std::vector<std::vector<size_t>>                m_node_queues;
+  std::vector<std::vector<size_t>>                m_victims;
+  std::array<std::atomic<size_t>, PRIORITY_COUNT> m_queued_per_priority;
+  std::chrono::steady_clock::time_point           m_start;
+  std::atomic<size_t>                             m_pending;
+  std::atomic<size_t>                             m_queued;
+  std::atomic<size_t>                             m_running;
+  std::atomic<size_t>                             m_waiting;
+  std::atomic<size_t>                             m_waiting_producers;
+  std::atomic<size_t>                             m_queued_high_water_mark;
+  std::atomic<size_t>                             m_running_high_water_mark;
+  std::atomic<size_t>                             m_next_queue;
+  std::atomic<bool>                               m_failed;
+  std::exception_ptr                              m_exception_ptr;
 
 }; /* End of ThreadPool class */
 
 } /* namespace Euclid */
 
+#include "AlexandriaKernel/_impl/ThreadPool.icpp"
+
 #endif
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file AlexandriaKernel/ThreadPoolStatistics.h
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#ifndef _ALEXANDRIAKERNEL_THREADPOOLSTATISTICS_H
+#define _ALEXANDRIAKERNEL_THREADPOOLSTATISTICS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Euclid {
+
+/**
+ * @class LatencyHistogram
+ *
+ * @brief A histogram of durations with logarithmic bins
+ *
+ * @details
+ * The bin i counts the durations in the range [2^i, 2^(i+1)) nanoseconds (the
+ * first bin also counts zero), so the histogram covers anything from
+ * nanoseconds to days with a fixed number of bins and a relative resolution of
+ * a factor of two. The percentiles are computed by interpolating linearly
+ * inside the bin they fall in.
+ */
+class LatencyHistogram {
+
+public:
+  /// The number of bins, enough for durations up to about three days
+  static constexpr size_t BIN_COUNT = 48;
+
+  /// Creates an empty histogram
+  LatencyHistogram();
+
+  /// Returns the index of the bin a duration (in nanoseconds) falls in
+  static size_t binIndex(std::uint64_t nanoseconds);
+
+  /// Returns the lower edge of a bin, in seconds
+  static double binLowerEdge(size_t bin);
+
+  /// Returns the upper edge of a bin, in seconds
+  static double binUpperEdge(size_t bin);
+
+  /// Adds count entries to the given bin
+  void add(size_t bin, std::uint64_t count = 1);
+
+  /// Adds all the entries of another histogram to this one
+  void merge(const LatencyHistogram& other);
+
+  /// Returns the number of entries in each bin
+  const std::array<std::uint64_t, BIN_COUNT>& bins() const;
+
+  /// Returns the total number of entries
+  std::uint64_t count() const;
+
+  /**
+   * @brief Returns an estimation of a percentile of the durations, in seconds
+   * @param fraction
+   *    The percentile as a fraction in the range [0, 1]
+   * @return
+   *    The estimated duration, or zero if the histogram is empty
+   */
+  double percentile(double fraction) const;
+
+private:
+  std::array<std::uint64_t, BIN_COUNT> m_bins;
+};
+
+/**
+ * @struct ThreadPoolStatistics
+ *
+ * @brief A snapshot of the statistics of a ThreadPool
+ *
+ * @details
+ * The task and steal counters are always collected. The busy time of the
+ * workers and the two histograms are only filled when the pool has been
+ * created with ThreadPool::Options::collect_timings set. All the times are in
+ * seconds. Tasks executed by threads outside the pool (for example while
+ * waiting for a TaskGroup) are included in the totals and the histograms, but
+ * not in the per worker figures.
+ */
+struct ThreadPoolStatistics {
+
+  /// The statistics of a single worker
+  struct Worker {
+    /// The number of tasks the worker has executed
+    std::uint64_t tasks_executed = 0;
+    /// The number of executed tasks taken from the queue of another worker
+    std::uint64_t tasks_stolen = 0;
+    /// The total time spent executing tasks
+    double busy_time = 0;
+  };
+
+  /// True if the busy times and the histograms have been collected
+  bool timings_collected = false;
+  /// The time since the pool has been created
+  double uptime = 0;
+  /// The total number of executed tasks
+  std::uint64_t tasks_executed = 0;
+  /// The total number of stolen tasks
+  std::uint64_t tasks_stolen = 0;
+  /// The number of tasks waiting in the queue
+  size_t queued = 0;
+  /// The number of tasks currently executing
+  size_t running = 0;
+  /// The maximum number of tasks which have been queued at the same time
+  size_t queued_high_water_mark = 0;
+  /// The maximum number of tasks which have been running at the same time
+  size_t running_high_water_mark = 0;
+  /// The statistics of each worker of the pool
+  std::vector<Worker> workers;
+  /// The time the tasks waited in the queue before they started
+  LatencyHistogram queue_wait;
+  /// The time the tasks took to execute
+  LatencyHistogram task_duration;
+
+  /// Returns the fraction of the available worker time spent executing tasks
+  double utilization() const;
+
+  /// Returns the statistics as a JSON object
+  std::string toJson() const;
+};
+
+} /* namespace Euclid */
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file AlexandriaKernel/UniqueTask.h
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#ifndef _ALEXANDRIAKERNEL_UNIQUETASK_H
+#define _ALEXANDRIAKERNEL_UNIQUETASK_H
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+namespace Euclid {
+
+/**
+ * @class UniqueTask
+ *
+ * @brief A move-only wrapper of a callable which gets no parameters and returns void
+ *
+ * @details
+ * Unlike std::function, the UniqueTask does not require the callable to be
+ * copyable, so it can hold objects like std::packaged_task or lambdas which
+ * capture move-only state, and it never copies the captured state.
+ *
+ * Callables up to INLINE_SIZE bytes, which can be moved without throwing, are
+ * stored inside the UniqueTask itself, so creating, moving and destroying the
+ * task does not allocate any memory. Bigger callables are moved to the heap.
+ */
+class UniqueTask {
+
+public:
+  /// The size of the callables which are stored without any heap allocation
+  static constexpr std::size_t INLINE_SIZE = 6 * sizeof(void*);
+
+  /// Constructs an empty task
+  UniqueTask() noexcept : m_ops(nullptr) {}
+
+  /// Constructs an empty task
+  UniqueTask(std::nullptr_t) noexcept : m_ops(nullptr) {}  // NOLINT(runtime/explicit)
+
+  /// Constructs a task which calls the given callable
+  template <typename F, typename = typename std::enable_if<
+                            !std::is_same<typename std::decay<F>::type, UniqueTask>::value>::type>
+  UniqueTask(F&& func);  // NOLINT(runtime/explicit)
+
+  UniqueTask(UniqueTask&& other) noexcept;
+
+  UniqueTask& operator=(UniqueTask&& other) noexcept;
+
+  /// Destroys the stored callable, leaving the task empty
+  UniqueTask& operator=(std::nullptr_t) noexcept;
+
+  UniqueTask(const UniqueTask&) = delete;
+  UniqueTask& operator=(const UniqueTask&) = delete;
+
+  ~UniqueTask();
+
+  /// Calls the stored callable. Like std::function, it throws std::bad_function_call
+  /// if the task is empty.
+  void operator()() {
+    if (m_ops == nullptr) {
+      throw std::bad_function_call();
+    }
+    m_ops->invoke(&m_storage);
+  }
+
+  /// Returns true if the task is not empty
+  explicit operator bool() const noexcept {
+    return m_ops != nullptr;
+  }
+
+  /// Returns true if the callable is stored inside the task, without any heap allocation
+  bool isInline() const noexcept;
+
+private:
+  using Storage = typename std::aligned_storage<INLINE_SIZE, alignof(std::max_align_t)>::type;
+
+  /// The type specific operations on the storage
+  struct Operations {
+    void (*invoke)(Storage*);
+    /// Move constructs the callable of src into dst and destroys the one of src
+    void (*relocate)(Storage* dst, Storage* src);
+    void (*destroy)(Storage*);
+    bool is_inline;
+  };
+
+  template <typename F>
+  struct InlineOperations;
+
+  template <typename F>
+  struct HeapOperations;
+
+  /// Stores the callable inside m_storage
+  template <typename F>
+  void construct(F&& func, std::true_type);
+
+  /// Stores a pointer to a heap allocated copy of the callable inside m_storage
+  template <typename F>
+  void construct(F&& func, std::false_type);
+
+  template <typename F>
+  using FitsInline =
+      std::integral_constant<bool, sizeof(F) <= sizeof(Storage) && alignof(Storage) % alignof(F) == 0 &&
+                                       std::is_nothrow_move_constructible<F>::value>;
+
+  Storage           m_storage;
+  const Operations* m_ops;
+};
+
+}  // namespace Euclid
+
+#include "AlexandriaKernel/_impl/UniqueTask.icpp"
+
+#endif  // _ALEXANDRIAKERNEL_UNIQUETASK_H
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file src/lib/Numa.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include "AlexandriaKernel/Numa.h"
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef ALEXANDRIA_HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+namespace Euclid {
+namespace Numa {
+
+bool available() {
+#ifdef ALEXANDRIA_HAVE_LIBNUMA
+  static const bool is_available = (numa_available() >= 0);
+  return is_available;
+#else
+  return false;
+#endif
+}
+
+int nodeCount() {
+#ifdef ALEXANDRIA_HAVE_LIBNUMA
+  if (available()) {
+    return numa_max_node() + 1;
+  }
+#endif
+  return 1;
+}
+
+int nodeOfCpu(unsigned int cpu) {
+#ifdef ALEXANDRIA_HAVE_LIBNUMA
+  if (available()) {
+    int node = numa_node_of_cpu(static_cast<int>(cpu));
+    return node < 0 ? 0 : node;
+  }
+#endif
+  (void)cpu;
+  return 0;
+}
+
+int nodeOfAddress(const void* address) {
+#ifdef ALEXANDRIA_HAVE_LIBNUMA
+  if (available() && address != nullptr) {
+    // Without target nodes move_pages() only reports where the page is. Unlike
+    // get_mempolicy() it does not fault in pages which are not touched yet, so
+    // querying does not change the placement.
+    void* pages[1]  = {const_cast<void*>(address)};
+    int   status[1] = {-1};
+    if (numa_move_pages(0, 1, pages, nullptr, status, 0) == 0 && status[0] >= 0) {
+      return status[0];
+    }
+  }
+#endif
+  (void)address;
+  return -1;
+}
+
+std::vector<unsigned int> allowedCpus() {
+  std::vector<unsigned int> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  if (cpus.empty()) {
+    for (unsigned int cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+bool pinCurrentThread(unsigned int cpu) {
+#ifdef __linux__
+  if (cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+}  // namespace Numa
+}  // namespace Euclid
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file src/lib/TaskGroup.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include "AlexandriaKernel/TaskGroup.h"
+#include <chrono>
+
+namespace Euclid {
+
+namespace {
+
+/// Time between checks for new pool tasks while waiting for tasks running in other threads
+constexpr std::chrono::milliseconds s_help_interval{1};
+
+}  // namespace
+
+void TaskGroup::State::fail(std::exception_ptr exception) {
+  std::lock_guard<std::mutex> lock{mutex};
+  if (exception_ptr == nullptr) {
+    exception_ptr = exception;
+  }
+}
+
+void TaskGroup::State::finish() {
+  if (--pending == 0) {
+    {
+      // Take the lock so the notification can not get lost
+      std::lock_guard<std::mutex> lock{mutex};
+      done_cv.notify_all();
+    }
+    pool.notifyIdle();
+  }
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool) : m_pool(pool), m_state(std::make_shared<State>(pool)) {}
+
+TaskGroup::TaskGroup(ThreadPool& pool, CancellationToken token) : TaskGroup(pool) {
+  m_state->token = std::move(token);
+}
+
+TaskGroup::~TaskGroup() {
+  try {
+    block();
+  } catch (...) {
+  }
+}
+
+void TaskGroup::block() {
+  while (m_state->pending > 0) {
+    // A worker waiting for a group blocks one of the threads which might have
+    // to run the tasks of the group, so it helps the pool instead of sleeping.
+    // Other threads only help if there are no workers left to do the job, or
+    // if the pool has failed, as its workers do not start any new task then.
+    bool help = m_pool.isWorkerThread() || m_pool.activeThreads() == 0 || m_pool.m_failed;
+    if (help && m_pool.tryRunPendingTask()) {
+      continue;
+    }
+    if (help) {
+      // Wake up from time to time, in case there is more work we can help with
+      std::unique_lock<std::mutex> lock{m_state->mutex};
+      m_state->done_cv.wait_for(lock, s_help_interval, [this]() { return m_state->pending == 0; });
+    } else {
+      // The pool notifies its idle condition when it fails, and so does the last task of the group
+      std::unique_lock<std::mutex> lock{m_pool.m_queue_mutex};
+      m_pool.m_idle_cv.wait(lock, [this]() { return m_state->pending == 0 || m_pool.m_failed; });
+    }
+  }
+  checkForException(true);
+}
+
+bool TaskGroup::checkForException(bool rethrow) {
+  std::lock_guard<std::mutex> lock{m_state->mutex};
+  if (m_state->exception_ptr) {
+    if (rethrow) {
+      std::rethrow_exception(m_state->exception_ptr);
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskGroup::cancel() {
+  m_state->token.cancel();
+}
+
+bool TaskGroup::isCancelled() const {
+  return m_state->token.isCancelled();
+}
+
+const CancellationToken& TaskGroup::token() const {
+  return m_state->token;
+}
+
+size_t TaskGroup::pending() const {
+  return m_state->pending;
+}
+
+}  // namespace Euclid
@@ -23,98 +23,445 @@
  */
 
 #include "AlexandriaKernel/ThreadPool.h"
+#include "AlexandriaKernel/Numa.h"
 #include "AlexandriaKernel/memory_tools.h"
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <map>
 #include <numeric>
 
 namespace Euclid {
 
+constexpr size_t ThreadPool::PRIORITY_COUNT;
+
 namespace {
 
-class Worker {
+/// Raises the value of max to value, if it is smaller
+void updateMaximum(std::atomic<size_t>& max, size_t value) {
+  size_t current = max.load();
+  while (current < value && !max.compare_exchange_weak(current, value)) {
+  }
+}
+
+using Clock = std::chrono::steady_clock;
+
+/// Adds value to a counter. The counters are only read for the statistics, so
+/// they need no ordering with respect to the other memory operations.
+void increment(std::atomic<std::uint64_t>& counter, std::uint64_t value = 1) {
+  counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::uint64_t toNanoseconds(Clock::duration duration) {
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+/// The pool and the index of the worker the current thread belongs to, if any
+thread_local ThreadPool* s_current_pool         = nullptr;
+thread_local size_t      s_current_worker_index = 0;
+
+/**
+ * A double ended queue stored in a circular buffer. The buffer doubles when it
+ * is full and halves when less than a quarter of it is used, but it never gets
+ * smaller than its initial capacity. The gap between the two thresholds means
+ * that a queue oscillating around a size does not keep reallocating, while the
+ * memory kept after a big burst of tasks is bounded by the current size.
+ */
+template <typename T>
+class RingBuffer {
 
 public:
-  Worker(std::mutex& queue_mutex, std::deque<ThreadPool::Task>& queue, std::atomic<bool>& run_flag,
-         std::atomic<bool>& sleeping_flag, std::atomic<bool>& done_flag, unsigned int empty_queue_wait_time,
-         std::exception_ptr& exception_ptr)
-      : m_queue_mutex(queue_mutex)
-      , m_queue(queue)
-      , m_run_flag(run_flag)
-      , m_sleeping_flag(sleeping_flag)
-      , m_done_flag(done_flag)
-      , m_empty_queue_wait_time(empty_queue_wait_time)
-      , m_exception_ptr(exception_ptr) {}
+  explicit RingBuffer(size_t initial_capacity)
+      : m_buffer(initial_capacity), m_initial_capacity(initial_capacity), m_head(0), m_size(0) {}
 
-  void operator()() {
-    while (m_run_flag.get() && m_exception_ptr == nullptr) {
-      // Check if there is anything it the queue to be done and get it
-      std::unique_ptr<ThreadPool::Task> task_ptr = nullptr;
-      std::unique_lock<std::mutex>      lock{m_queue_mutex.get()};
-      if (!m_queue.get().empty()) {
-        task_ptr = Euclid::make_unique<ThreadPool::Task>(m_queue.get().front());
-        m_queue.get().pop_front();
+  bool empty() const {
+    return m_size == 0;
+  }
+
+  size_t size() const {
+    return m_size;
+  }
+
+  void push_back(T&& value) {
+    if (m_size == m_buffer.size()) {
+      reallocate(std::max<size_t>(2 * m_buffer.size(), 16));
+    }
+    m_buffer[(m_head + m_size) % m_buffer.size()] = std::move(value);
+    ++m_size;
+  }
+
+  void pop_front(T& value) {
+    value  = std::move(m_buffer[m_head]);
+    m_head = (m_head + 1) % m_buffer.size();
+    --m_size;
+    shrinkIfSparse();
+  }
+
+  void pop_back(T& value) {
+    --m_size;
+    value = std::move(m_buffer[(m_head + m_size) % m_buffer.size()]);
+    shrinkIfSparse();
+  }
+
+private:
+  void shrinkIfSparse() {
+    if (m_buffer.size() > m_initial_capacity && m_size < m_buffer.size() / 4) {
+      reallocate(std::max(m_buffer.size() / 2, m_initial_capacity));
+    }
+  }
+
+  void reallocate(size_t capacity) {
+    std::vector<T> buffer(capacity);
+    for (size_t i = 0; i < m_size; ++i) {
+      buffer[i] = std::move(m_buffer[(m_head + i) % m_buffer.size()]);
+    }
+    m_buffer.swap(buffer);
+    m_head = 0;
+  }
+
+  std::vector<T> m_buffer;
+  size_t         m_initial_capacity;
+  size_t         m_head;
+  size_t         m_size;
+};
+
+/// The number of tasks each queue can hold before it has to grow
+constexpr size_t s_initial_queue_capacity = 1024;
+
+/// The initial capacity of the low and high priority lanes
+constexpr size_t s_small_lane_capacity = 16;
+
+/// Returns the CPU each worker is bound to, or -1 for the workers which are not bound
+std::vector<int> assignCpus(const ThreadPool::Options& options) {
+  std::vector<unsigned int> cpus = options.cores;
+  if (cpus.empty() && options.affinity != ThreadPool::Affinity::None) {
+    std::map<int, std::vector<unsigned int>> node_cpus;
+    for (auto cpu : Numa::allowedCpus()) {
+      node_cpus[Numa::nodeOfCpu(cpu)].push_back(cpu);
+    }
+    if (options.affinity == ThreadPool::Affinity::Compact) {
+      for (auto& node : node_cpus) {
+        cpus.insert(cpus.end(), node.second.begin(), node.second.end());
+      }
+    } else {
+      // Take one CPU from each node in turn
+      size_t longest = 0;
+      for (auto& node : node_cpus) {
+        longest = std::max(longest, node.second.size());
       }
-      lock.unlock();
-
-      // If we have some work to do, do it. Otherwise sleep for some time.
-      if (task_ptr) {
-        try {
-          (*task_ptr)();
-        } catch (...) {
-          m_exception_ptr.get() = std::current_exception();
+      for (size_t i = 0; i < longest; ++i) {
+        for (auto& node : node_cpus) {
+          if (i < node.second.size()) {
+            cpus.push_back(node.second[i]);
+          }
         }
+      }
+    }
+  }
+
+  std::vector<int> worker_cpus(options.thread_count, -1);
+  for (size_t i = 0; i < worker_cpus.size() && !cpus.empty(); ++i) {
+    worker_cpus[i] = static_cast<int>(cpus[i % cpus.size()]);
+  }
+  return worker_cpus;
+}
+
+}  // end of anonymous namespace
+
+/// A task in the queue, together with the time it was submitted (only set when
+/// the timings are collected)
+struct ThreadPool::QueuedTask {
+  UniqueTask        task;
+  Clock::time_point submitted;
+};
+
+/// A queue with a lane for each priority. Most tasks are expected to have the
+/// normal priority, so the other lanes start small.
+struct ThreadPool::TaskQueue {
+  std::mutex                                         mutex;
+  std::array<RingBuffer<QueuedTask>, PRIORITY_COUNT> lanes{{RingBuffer<QueuedTask>{s_small_lane_capacity},
+                                                            RingBuffer<QueuedTask>{s_initial_queue_capacity},
+                                                            RingBuffer<QueuedTask>{s_small_lane_capacity}}};
+};
+
+/// The statistics counters of a single worker. Each worker has its own, so
+/// updating them does not cause any contention between the workers.
+struct ThreadPool::WorkerCounters {
+  using Bins = std::array<std::atomic<std::uint64_t>, LatencyHistogram::BIN_COUNT>;
+
+  WorkerCounters() : tasks_executed(0), tasks_stolen(0), busy_nanoseconds(0) {
+    for (auto& bin : queue_wait) {
+      bin = 0;
+    }
+    for (auto& bin : task_duration) {
+      bin = 0;
+    }
+  }
+
+  std::atomic<std::uint64_t> tasks_executed;
+  std::atomic<std::uint64_t> tasks_stolen;
+  std::atomic<std::uint64_t> busy_nanoseconds;
+  Bins                       queue_wait;
+  Bins                       task_duration;
+};
+
+class ThreadPool::Worker {
+
+public:
+  Worker(ThreadPool& pool, size_t index) : m_pool(pool), m_index(index) {}
+
+  void operator()() {
+    ThreadPool&                pool     = m_pool.get();
+    std::atomic<bool>&         run_flag = pool.m_worker_run_flags.at(m_index);
+    const ThreadPool::Options& options  = pool.m_options;
+
+    s_current_pool         = &pool;
+    s_current_worker_index = m_index;
+
+    // Failing to pin the thread only affects the performance, so it is not an error
+    if (pool.m_worker_cpus[m_index] >= 0) {
+      Numa::pinCurrentThread(static_cast<unsigned int>(pool.m_worker_cpus[m_index]));
+    }
+
+    ThreadPool::QueuedTask entry;
+    bool                   stolen = false;
+    while (run_flag && !pool.m_failed) {
+      // If we have some work to do, do it. Otherwise, either sleep for some
+      // time or wait until we get notified that something was submitted.
+      if (pool.popTask(m_index, entry, stolen)) {
+        pool.runTask(entry, stolen);
+      } else if (options.event_driven) {
+        std::unique_lock<std::mutex> lock{pool.m_queue_mutex};
+        ++pool.m_waiting;
+        pool.m_queue_cv.wait(lock, [&pool, &run_flag]() {
+          return pool.m_queued > 0 || !run_flag || pool.m_failed;
+        });
+        --pool.m_waiting;
       } else {
-        m_sleeping_flag.get() = true;
-        std::this_thread::sleep_for(std::chrono::milliseconds(m_empty_queue_wait_time));
-        m_sleeping_flag.get() = false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.empty_queue_wait_time));
       }
     }
     // Indicate that the worker is done
-    m_sleeping_flag.get() = true;
-    m_done_flag.get()     = true;
-    m_run_flag.get()      = false;
+    pool.m_worker_done_flags.at(m_index) = true;
+    run_flag                             = false;
+    s_current_pool                       = nullptr;
   }
 
 private:
-  std::reference_wrapper<std::mutex>                   m_queue_mutex;
-  std::reference_wrapper<std::deque<ThreadPool::Task>> m_queue;
-  std::reference_wrapper<std::atomic<bool>>            m_run_flag;
-  std::reference_wrapper<std::atomic<bool>>            m_sleeping_flag;
-  std::reference_wrapper<std::atomic<bool>>            m_done_flag;
-  unsigned int                                         m_empty_queue_wait_time;
-  std::reference_wrapper<std::exception_ptr>           m_exception_ptr;
+  std::reference_wrapper<ThreadPool> m_pool;
+  size_t                             m_index;
 };
 
-}  // end of anonymous namespace
-
 ThreadPool::ThreadPool(unsigned int thread_count, unsigned int empty_queue_wait_time)
-    : m_worker_run_flags(thread_count)
-    , m_worker_sleeping_flags(thread_count)
-    , m_worker_done_flags(thread_count)
-    , m_empty_queue_wait_time(empty_queue_wait_time) {
-  for (unsigned int i = 0; i < thread_count; ++i) {
-    m_worker_run_flags.at(i)      = true;
-    m_worker_sleeping_flags.at(i) = false;
-    m_worker_done_flags.at(i)     = false;
-    m_workers.emplace_back(Worker{m_queue_mutex, m_queue, m_worker_run_flags.at(i), m_worker_sleeping_flags.at(i),
-                                  m_worker_done_flags.at(i), m_empty_queue_wait_time, m_exception_ptr});
+    : ThreadPool([thread_count, empty_queue_wait_time]() {
+      Options options;
+      options.thread_count          = thread_count;
+      options.empty_queue_wait_time = empty_queue_wait_time;
+      return options;
+    }()) {}
+
+ThreadPool::ThreadPool(const Options& options)
+    : m_options(options)
+    , m_worker_run_flags(options.thread_count)
+    , m_worker_done_flags(options.thread_count)
+    , m_start(Clock::now())
+    , m_pending(0)
+    , m_queued(0)
+    , m_running(0)
+    , m_waiting(0)
+    , m_waiting_producers(0)
+    , m_queued_high_water_mark(0)
+    , m_running_high_water_mark(0)
+    , m_next_queue(0)
+    , m_failed(false) {
+  for (auto& queued : m_queued_per_priority) {
+    queued = 0;
+  }
+  // The queues are NUMA local only if all the workers are bound to CPUs and
+  // they are spread over more than one node
+  m_worker_cpus = assignCpus(options);
+  std::vector<int> worker_nodes(options.thread_count, 0);
+  if (options.numa_local_queues && std::find(m_worker_cpus.begin(), m_worker_cpus.end(), -1) == m_worker_cpus.end()) {
+    for (unsigned int i = 0; i < options.thread_count; ++i) {
+      worker_nodes[i] = Numa::nodeOfCpu(static_cast<unsigned int>(m_worker_cpus[i]));
+    }
+    m_numa_nodes = worker_nodes;
+    std::sort(m_numa_nodes.begin(), m_numa_nodes.end());
+    m_numa_nodes.erase(std::unique(m_numa_nodes.begin(), m_numa_nodes.end()), m_numa_nodes.end());
+    if (m_numa_nodes.size() < 2) {
+      m_numa_nodes.clear();
+    }
+  }
+  // From here on the nodes are identified by their index in m_numa_nodes
+  for (auto& node : worker_nodes) {
+    auto it = std::lower_bound(m_numa_nodes.begin(), m_numa_nodes.end(), node);
+    node    = (it != m_numa_nodes.end() && *it == node) ? static_cast<int>(it - m_numa_nodes.begin()) : 0;
+  }
+
+  // With work stealing each worker has its own queue, otherwise there is one
+  // queue shared by the workers of each node
+  if (options.scheduling == Scheduling::WorkStealing) {
+    for (unsigned int i = 0; i < options.thread_count; ++i) {
+      m_worker_queues.push_back(i);
+      m_queue_nodes.push_back(static_cast<size_t>(worker_nodes[i]));
+    }
+  } else {
+    for (size_t node = 0; node < std::max<size_t>(m_numa_nodes.size(), 1); ++node) {
+      m_queue_nodes.push_back(node);
+    }
+    m_worker_queues.assign(worker_nodes.begin(), worker_nodes.end());
+  }
+  m_node_queues.resize(std::max<size_t>(m_numa_nodes.size(), 1));
+  for (size_t i = 0; i < m_queue_nodes.size(); ++i) {
+    m_queues.emplace_back(Euclid::make_unique<TaskQueue>());
+    m_node_queues[m_queue_nodes[i]].push_back(i);
+  }
+  // Each worker looks first in its own queue, then in the rest of the queues of
+  // its node and finally in the queues of the other nodes
+  size_t queue_count = m_queues.size();
+  for (unsigned int i = 0; i < options.thread_count; ++i) {
+    std::vector<size_t> victims;
+    for (size_t j = 0; j < queue_count; ++j) {
+      victims.push_back((m_worker_queues[i] + j) % queue_count);
+    }
+    std::stable_partition(victims.begin() + 1, victims.end(), [this, &victims](size_t queue) {
+      return m_queue_nodes[queue] == m_queue_nodes[victims.front()];
+    });
+    m_victims.push_back(std::move(victims));
+  }
+  // One set of counters per worker, plus one shared by any other thread running tasks
+  for (unsigned int i = 0; i <= options.thread_count; ++i) {
+    m_counters.emplace_back(Euclid::make_unique<WorkerCounters>());
+  }
+  for (unsigned int i = 0; i < options.thread_count; ++i) {
+    m_worker_run_flags.at(i)  = true;
+    m_worker_done_flags.at(i) = false;
+  }
+  for (unsigned int i = 0; i < options.thread_count; ++i) {
+    m_workers.emplace_back(Worker{*this, i});
   }
 }
 
-namespace {
+bool ThreadPool::popTask(size_t worker_index, QueuedTask& entry, bool& stolen) {
+  if (m_queued == 0 || m_victims.empty()) {
+    return false;
+  }
+  // The tasks of higher priority come first, wherever they are queued. With a
+  // shared queue everybody gets the oldest task. With work stealing the worker
+  // gets its newest task, or steals the oldest one of somebody else.
+  auto&  victims     = m_victims[worker_index];
+  size_t queue_count = m_queues.size();
+  for (size_t priority = PRIORITY_COUNT; priority-- > 0;) {
+    if (m_queued_per_priority[priority] == 0) {
+      continue;
+    }
+    for (size_t i = 0; i < queue_count; ++i) {
+      auto&                       queue = *m_queues[victims[i]];
+      std::lock_guard<std::mutex> lock{queue.mutex};
+      auto&                       lane = queue.lanes[priority];
+      if (lane.empty()) {
+        continue;
+      }
+      if (m_options.scheduling == Scheduling::WorkStealing && i == 0) {
+        lane.pop_back(entry);
+      } else {
+        lane.pop_front(entry);
+      }
+      --m_queued_per_priority[priority];
+      stolen = (queue_count > 1 && i != 0);
+      // Mark it as running before it stops being queued, so the pool never looks idle
+      updateMaximum(m_running_high_water_mark, ++m_running);
+      --m_queued;
+      // Let any producer waiting for space know. The lock guarantees the producer
+      // is either blocked already or will see the new queue size.
+      if (m_waiting_producers > 0) {
+        {
+          std::lock_guard<std::mutex> lock{m_queue_mutex};
+        }
+        m_space_cv.notify_one();
+      }
+      return true;
+    }
+  }
+  return false;
+}
 
-void waitWorkers(std::vector<std::atomic<bool>>& worker_flags, unsigned int wait_time) {
-  // Now wait until all the workers have finish any current tasks
-  for (auto& flag : worker_flags) {
-    while (!flag) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(wait_time));
+void ThreadPool::runTask(QueuedTask& entry, bool stolen) {
+  auto& counters = *m_counters[isWorkerThread() ? s_current_worker_index : m_counters.size() - 1];
+  Clock::time_point start;
+  if (m_options.collect_timings) {
+    start = Clock::now();
+    increment(counters.queue_wait[LatencyHistogram::binIndex(toNanoseconds(start - entry.submitted))]);
+  }
+
+  std::exception_ptr exception_ptr = nullptr;
+  try {
+    entry.task();
+  } catch (...) {
+    exception_ptr = std::current_exception();
+  }
+  // Release whatever the task captured before reporting it as finished
+  entry.task = nullptr;
+
+  if (m_options.collect_timings) {
+    auto duration = toNanoseconds(Clock::now() - start);
+    increment(counters.busy_nanoseconds, duration);
+    increment(counters.task_duration[LatencyHistogram::binIndex(duration)]);
+  }
+  increment(counters.tasks_executed);
+  if (stolen && isWorkerThread()) {
+    increment(counters.tasks_stolen);
+  }
+
+  if (exception_ptr != nullptr) {
+    std::lock_guard<std::mutex> lock{m_queue_mutex};
+    if (m_exception_ptr == nullptr) {
+      m_exception_ptr = exception_ptr;
+    }
+    m_failed = true;
+  }
+  --m_running;
+  if (--m_pending == 0 || m_failed) {
+    // Take the lock so the notification can not get lost between the waiting
+    // thread checking its condition and going to sleep
+    {
+      std::lock_guard<std::mutex> lock{m_queue_mutex};
+    }
+    m_idle_cv.notify_all();
+    if (m_failed) {
+      m_queue_cv.notify_all();
+      m_space_cv.notify_all();
     }
   }
 }
 
-}  // namespace
+bool ThreadPool::tryRunPendingTask() {
+  size_t     worker_index = (s_current_pool == this) ? s_current_worker_index : 0;
+  QueuedTask entry;
+  bool       stolen = false;
+  if (!popTask(worker_index, entry, stolen)) {
+    return false;
+  }
+  runTask(entry, stolen);
+  return true;
+}
+
+bool ThreadPool::isWorkerThread() const {
+  return s_current_pool == this;
+}
+
+void ThreadPool::notifyIdle() {
+  // Take the lock so the notification can not get lost between the waiting
+  // thread checking its condition and going to sleep
+  {
+    std::lock_guard<std::mutex> lock{m_queue_mutex};
+  }
+  m_idle_cv.notify_all();
+}
 
 bool ThreadPool::checkForException(bool rethrow) {
+  std::unique_lock<std::mutex> lock{m_queue_mutex};
   if (m_exception_ptr) {
     if (rethrow) {
       std::rethrow_exception(m_exception_ptr);
@@ -126,14 +473,11 @@ bool ThreadPool::checkForException(bool rethrow) {
 }
 
 size_t ThreadPool::queued() const {
-  std::unique_lock<std::mutex> lock{m_queue_mutex};
-  return m_queue.size();
+  return m_queued;
 }
 
 size_t ThreadPool::running() const {
-  std::unique_lock<std::mutex> lock{m_queue_mutex};
-  auto sleeping = std::accumulate(m_worker_sleeping_flags.begin(), m_worker_sleeping_flags.end(), 0);
-  return m_worker_sleeping_flags.size() - sleeping;
+  return m_running;
 }
 
 size_t ThreadPool::activeThreads() const {
@@ -141,19 +485,59 @@ size_t ThreadPool::activeThreads() const {
   return m_worker_done_flags.size() - done;
 }
 
-void ThreadPool::block() {
-  // Wait for the queue to be empty
-  bool queue_is_empty = false;
-  while (!queue_is_empty && m_exception_ptr == nullptr) {
-    std::unique_lock<std::mutex> lock{m_queue_mutex};
-    queue_is_empty = m_queue.empty();
-    lock.unlock();
-    if (!queue_is_empty) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(m_empty_queue_wait_time));
+size_t ThreadPool::queueCapacity() const {
+  return m_options.queue_capacity;
+}
+
+size_t ThreadPool::queuedHighWaterMark() const {
+  return m_queued_high_water_mark;
+}
+
+size_t ThreadPool::runningHighWaterMark() const {
+  return m_running_high_water_mark;
+}
+
+ThreadPool::Statistics ThreadPool::statistics() const {
+  Statistics statistics;
+  statistics.timings_collected       = m_options.collect_timings;
+  statistics.uptime                  = std::chrono::duration<double>(Clock::now() - m_start).count();
+  statistics.queued                  = m_queued;
+  statistics.running                 = m_running;
+  statistics.queued_high_water_mark  = m_queued_high_water_mark;
+  statistics.running_high_water_mark = m_running_high_water_mark;
+  for (size_t i = 0; i < m_counters.size(); ++i) {
+    auto& counters       = *m_counters[i];
+    auto  tasks_executed = counters.tasks_executed.load(std::memory_order_relaxed);
+    auto  tasks_stolen   = counters.tasks_stolen.load(std::memory_order_relaxed);
+    statistics.tasks_executed += tasks_executed;
+    statistics.tasks_stolen += tasks_stolen;
+    for (size_t bin = 0; bin < LatencyHistogram::BIN_COUNT; ++bin) {
+      statistics.queue_wait.add(bin, counters.queue_wait[bin].load(std::memory_order_relaxed));
+      statistics.task_duration.add(bin, counters.task_duration[bin].load(std::memory_order_relaxed));
+    }
+    // The last counters belong to the threads outside of the pool
+    if (i < m_workers.size()) {
+      Statistics::Worker worker;
+      worker.tasks_executed = tasks_executed;
+      worker.tasks_stolen   = tasks_stolen;
+      worker.busy_time      = counters.busy_nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+      statistics.workers.push_back(worker);
     }
   }
-  // Wait for the workers to finish the currently executing tasks
-  waitWorkers(m_worker_sleeping_flags, m_empty_queue_wait_time);
+  return statistics;
+}
+
+const std::vector<int>& ThreadPool::numaNodes() const {
+  return m_numa_nodes;
+}
+
+void ThreadPool::block() {
+  // Wait for the queue to be empty and the workers to finish the currently
+  // executing tasks. If any of the tasks failed, the workers stop getting new
+  // tasks, so we only wait for the ones already running.
+  std::unique_lock<std::mutex> lock{m_queue_mutex};
+  m_idle_cv.wait(lock, [this]() { return m_pending == 0 || (m_failed && m_running == 0); });
+  lock.unlock();
   // Check if any worker finished with an exception
   checkForException(true);
 }
@@ -161,20 +545,140 @@ void ThreadPool::block() {
 ThreadPool::~ThreadPool() {
   // Stop all the workers. They will stop right after they finish the task
   // they already run.
-  std::fill(m_worker_run_flags.begin(), m_worker_run_flags.end(), false);
+  {
+    std::lock_guard<std::mutex> lock{m_queue_mutex};
+    std::fill(m_worker_run_flags.begin(), m_worker_run_flags.end(), false);
+  }
+  m_queue_cv.notify_all();
   // Now wait until all the workers have finish any current tasks
-  waitWorkers(m_worker_done_flags, m_empty_queue_wait_time);
   for (auto& worker : m_workers) {
     worker.join();
   }
+  cancelAll();
+}
+
+size_t ThreadPool::cancelAll() {
+  // Take the tasks out of the queues and destroy them without holding any lock,
+  // as their destructors may use the pool (for example to notify a TaskGroup)
+  std::vector<QueuedTask> discarded;
+  for (auto& queue : m_queues) {
+    std::lock_guard<std::mutex> lock{queue->mutex};
+    for (size_t priority = 0; priority < PRIORITY_COUNT; ++priority) {
+      auto& lane = queue->lanes[priority];
+      while (!lane.empty()) {
+        discarded.emplace_back();
+        lane.pop_front(discarded.back());
+        --m_queued_per_priority[priority];
+        --m_queued;
+      }
+    }
+  }
+  size_t count = discarded.size();
+  discarded.clear();
+
+  if (count > 0) {
+    m_pending -= count;
+    {
+      std::lock_guard<std::mutex> lock{m_queue_mutex};
+    }
+    m_idle_cv.notify_all();
+    m_space_cv.notify_all();
+  }
+  return count;
+}
+
+bool ThreadPool::tryReserveSlot() {
+  size_t queued = m_queued;
+  do {
+    if (m_options.queue_capacity > 0 && queued >= m_options.queue_capacity) {
+      return false;
+    }
+  } while (!m_queued.compare_exchange_weak(queued, queued + 1));
+  updateMaximum(m_queued_high_water_mark, queued + 1);
+  return true;
+}
+
+void ThreadPool::submit(UniqueTask task) {
+  submitTask(std::move(task), -1, Priority::Normal);
+}
+
+void ThreadPool::submit(UniqueTask task, Priority priority) {
+  submitTask(std::move(task), -1, priority);
+}
+
+void ThreadPool::submitToNode(UniqueTask task, int node) {
+  submitTask(std::move(task), node, Priority::Normal);
 }
 
-void ThreadPool::submit(Task task) {
-  std::lock_guard<std::mutex> lock{m_queue_mutex};
-  if (m_worker_run_flags.empty()) {
+void ThreadPool::submitTask(UniqueTask task, int node, Priority priority) {
+  if (m_workers.empty()) {
     task();
-  } else {
-    m_queue.emplace_back(std::move(task));
+    return;
+  }
+
+  if (!tryReserveSlot()) {
+    // A worker waiting for space might wait for itself, so it does the job directly
+    if (isWorkerThread()) {
+      task();
+      return;
+    }
+    // Wait until a worker picks up a task. If the pool has failed, nothing will
+    // ever be picked up, so the task is queued anyway, to be discarded.
+    std::unique_lock<std::mutex> lock{m_queue_mutex};
+    bool                         reserved = false;
+    ++m_waiting_producers;
+    m_space_cv.wait(lock, [this, &reserved]() {
+      reserved = tryReserveSlot();
+      return reserved || m_failed;
+    });
+    --m_waiting_producers;
+    if (!reserved) {
+      ++m_queued;
+    }
+  }
+  enqueue(std::move(task), node, priority);
+}
+
+void ThreadPool::enqueue(UniqueTask task, int node, Priority priority) {
+  // Tasks for a node go to the queues of that node, unless the submitting
+  // worker is on it already. Tasks submitted by a worker go to its own queue
+  // and the rest are distributed in a round robin fashion.
+  size_t queue_index = 0;
+  if (m_queues.size() > 1) {
+    auto node_it    = std::lower_bound(m_numa_nodes.begin(), m_numa_nodes.end(), node);
+    bool known_node = (node_it != m_numa_nodes.end() && *node_it == node);
+    auto node_index = static_cast<size_t>(node_it - m_numa_nodes.begin());
+    if (isWorkerThread() &&
+        (!known_node || m_queue_nodes[m_worker_queues[s_current_worker_index]] == node_index)) {
+      queue_index = m_worker_queues[s_current_worker_index];
+    } else if (known_node) {
+      auto& node_queues = m_node_queues[node_index];
+      queue_index       = node_queues[m_next_queue++ % node_queues.size()];
+    } else {
+      queue_index = m_next_queue++ % m_queues.size();
+    }
+  }
+
+  QueuedTask entry{std::move(task), Clock::time_point{}};
+  if (m_options.collect_timings) {
+    entry.submitted = Clock::now();
+  }
+
+  ++m_pending;
+  {
+    auto&                       queue = *m_queues[queue_index];
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    queue.lanes[static_cast<size_t>(priority)].push_back(std::move(entry));
+    ++m_queued_per_priority[static_cast<size_t>(priority)];
+  }
+
+  // Only pay for the notification if some worker is actually waiting. The lock
+  // guarantees the worker is either blocked already or will see the new task.
+  if (m_waiting > 0) {
+    {
+      std::lock_guard<std::mutex> lock{m_queue_mutex};
+    }
+    m_queue_cv.notify_one();
   }
 }
 
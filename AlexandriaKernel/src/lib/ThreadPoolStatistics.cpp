@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file src/lib/ThreadPoolStatistics.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include "AlexandriaKernel/ThreadPoolStatistics.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+namespace Euclid {
+
+namespace {
+
+void writeHistogram(std::ostream& out, const LatencyHistogram& histogram) {
+  out << "{\"count\": " << histogram.count() << ", \"p50\": " << histogram.percentile(0.5)
+      << ", \"p90\": " << histogram.percentile(0.9) << ", \"p99\": " << histogram.percentile(0.99)
+      << ", \"max\": " << histogram.percentile(1.) << ", \"bins\": [";
+  const auto& bins = histogram.bins();
+  for (size_t i = 0; i < bins.size(); ++i) {
+    out << (i > 0 ? ", " : "") << bins[i];
+  }
+  out << "]}";
+}
+
+}  // namespace
+
+constexpr size_t LatencyHistogram::BIN_COUNT;
+
+LatencyHistogram::LatencyHistogram() {
+  m_bins.fill(0);
+}
+
+size_t LatencyHistogram::binIndex(std::uint64_t nanoseconds) {
+  size_t bin = 0;
+  while (nanoseconds > 1 && bin < BIN_COUNT - 1) {
+    nanoseconds >>= 1;
+    ++bin;
+  }
+  return bin;
+}
+
+double LatencyHistogram::binLowerEdge(size_t bin) {
+  return (bin == 0) ? 0. : std::ldexp(1., static_cast<int>(bin)) * 1e-9;
+}
+
+double LatencyHistogram::binUpperEdge(size_t bin) {
+  return std::ldexp(1., static_cast<int>(bin) + 1) * 1e-9;
+}
+
+void LatencyHistogram::add(size_t bin, std::uint64_t count) {
+  m_bins.at(bin) += count;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < BIN_COUNT; ++i) {
+    m_bins[i] += other.m_bins[i];
+  }
+}
+
+const std::array<std::uint64_t, LatencyHistogram::BIN_COUNT>& LatencyHistogram::bins() const {
+  return m_bins;
+}
+
+std::uint64_t LatencyHistogram::count() const {
+  return std::accumulate(m_bins.begin(), m_bins.end(), std::uint64_t{0});
+}
+
+double LatencyHistogram::percentile(double fraction) const {
+  auto total = count();
+  if (total == 0) {
+    return 0.;
+  }
+  // The rank of the requested entry, counting from one
+  double rank = std::max(1., std::min(fraction, 1.) * total);
+  double seen = 0;
+  for (size_t i = 0; i < BIN_COUNT; ++i) {
+    if (m_bins[i] == 0) {
+      continue;
+    }
+    if (seen + m_bins[i] >= rank) {
+      double position = (rank - seen) / m_bins[i];
+      return binLowerEdge(i) + position * (binUpperEdge(i) - binLowerEdge(i));
+    }
+    seen += m_bins[i];
+  }
+  return binUpperEdge(BIN_COUNT - 1);
+}
+
+double ThreadPoolStatistics::utilization() const {
+  if (workers.empty() || uptime <= 0) {
+    return 0.;
+  }
+  double busy = 0;
+  for (auto& worker : workers) {
+    busy += worker.busy_time;
+  }
+  return busy / (uptime * workers.size());
+}
+
+std::string ThreadPoolStatistics::toJson() const {
+  std::ostringstream out;
+  out << "{\"threads\": " << workers.size() << ", \"uptime\": " << uptime
+      << ", \"timings_collected\": " << (timings_collected ? "true" : "false")
+      << ", \"tasks_executed\": " << tasks_executed << ", \"tasks_stolen\": " << tasks_stolen
+      << ", \"queued\": " << queued << ", \"running\": " << running
+      << ", \"queued_high_water_mark\": " << queued_high_water_mark
+      << ", \"running_high_water_mark\": " << running_high_water_mark << ", \"utilization\": " << utilization()
+      << ", \"workers\": [";
+  for (size_t i = 0; i < workers.size(); ++i) {
+    out << (i > 0 ? ", " : "") << "{\"tasks_executed\": " << workers[i].tasks_executed
+        << ", \"tasks_stolen\": " << workers[i].tasks_stolen << ", \"busy_time\": " << workers[i].busy_time << "}";
+  }
+  out << "], \"queue_wait\": ";
+  writeHistogram(out, queue_wait);
+  out << ", \"task_duration\": ";
+  writeHistogram(out, task_duration);
+  out << "}";
+  return out.str();
+}
+
+}  // namespace Euclid
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file src/program/ThreadPoolBenchmark.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "AlexandriaKernel/AllocationCounter.h"
+#include "AlexandriaKernel/ThreadPool.h"
+#include "ElementsKernel/ProgramHeaders.h"
+#include <boost/program_options.hpp>
+
+using boost::program_options::options_description;
+using boost::program_options::value;
+using boost::program_options::variable_value;
+using Euclid::ThreadPool;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double toMicroseconds(Clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / 1000.;
+}
+
+/// Measures the time between submitting a task to an idle pool and the task starting
+std::vector<double> measureLatency(ThreadPool& pool, size_t samples) {
+  std::vector<double> latencies;
+  latencies.reserve(samples);
+  for (size_t i = 0; i < samples; ++i) {
+    // Give the workers time to go idle
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::promise<Clock::time_point> started;
+    auto                            future = started.get_future();
+    auto                            submit = Clock::now();
+    pool.submit([&started]() { started.set_value(Clock::now()); });
+    latencies.push_back(toMicroseconds(future.get() - submit));
+  }
+  pool.block();
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+/// Measures the number of tiny tasks per second the pool can go through
+double measureThroughput(ThreadPool& pool, size_t ntasks) {
+  std::atomic<size_t> counter{0};
+  auto                start = Clock::now();
+  for (size_t i = 0; i < ntasks; ++i) {
+    pool.submit([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+  }
+  pool.block();
+  auto elapsed = Clock::now() - start;
+  if (counter != ntasks) {
+    throw std::runtime_error("Not all the tasks have been executed");
+  }
+  return ntasks / (toMicroseconds(elapsed) / 1e6);
+}
+
+/// Measures the number of tiny tasks per second when they are submitted from inside the pool,
+/// as it happens when the work is fanned out by a few coarse tasks
+double measureFanOut(ThreadPool& pool, size_t ntasks, size_t nseeds) {
+  std::atomic<size_t> counter{0};
+  size_t              per_seed = ntasks / nseeds;
+  auto                start    = Clock::now();
+  for (size_t i = 0; i < nseeds; ++i) {
+    pool.submit([&pool, &counter, per_seed]() {
+      for (size_t j = 0; j < per_seed; ++j) {
+        pool.submit([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+      }
+    });
+  }
+  pool.block();
+  auto elapsed = Clock::now() - start;
+  if (counter != per_seed * nseeds) {
+    throw std::runtime_error("Not all the tasks have been executed");
+  }
+  return per_seed * nseeds / (toMicroseconds(elapsed) / 1e6);
+}
+
+/// Measures the number of heap allocations per submitted and executed task
+double measureAllocations(ThreadPool& pool, size_t ntasks) {
+  std::atomic<size_t> counter{0};
+  // A warm up round, so the one-off allocations are not counted. The queues shrink
+  // again after each burst, so their growth is included, amortized over the tasks.
+  for (int round = 0; round < 2; ++round) {
+    auto before = Euclid::allocationCount();
+    for (size_t i = 0; i < ntasks; ++i) {
+      pool.submit([&counter, i]() { counter.fetch_add(i, std::memory_order_relaxed); });
+    }
+    pool.block();
+    if (round == 1) {
+      return static_cast<double>(Euclid::allocationCount() - before) / ntasks;
+    }
+  }
+  return 0;
+}
+
+const char* schedulingName(ThreadPool::Scheduling scheduling) {
+  switch (scheduling) {
+  case ThreadPool::Scheduling::Shared:
+    return "shared";
+  case ThreadPool::Scheduling::WorkStealing:
+    return "work-stealing";
+  }
+  return "unknown";
+}
+
+}  // namespace
+
+class ThreadPoolBenchmark : public Elements::Program {
+
+public:
+  options_description defineSpecificProgramOptions() override {
+    options_description options{};
+    options.add_options()("threads", value<unsigned int>()->default_value(std::thread::hardware_concurrency()),
+                          "Number of threads in the pool")(
+        "tasks", value<size_t>()->default_value(2000000), "Number of tiny tasks used for measuring the throughput")(
+        "latency-samples", value<size_t>()->default_value(200), "Number of submit-to-start latency measurements");
+    return options;
+  }
+
+  Elements::ExitCode mainMethod(std::map<std::string, variable_value>& args) override {
+    auto threads = args.at("threads").as<unsigned int>();
+    auto ntasks  = args.at("tasks").as<size_t>();
+    auto samples = args.at("latency-samples").as<size_t>();
+    if (samples == 0) {
+      throw std::invalid_argument("At least one latency sample is required");
+    }
+
+    std::cout << "Threads: " << threads << std::endl;
+    std::cout << std::setw(14) << "Mode" << std::setw(16) << "Latency p50 us" << std::setw(16) << "Latency p99 us"
+              << std::setw(16) << "Latency max us" << std::setw(16) << "Tasks/s" << std::endl;
+
+    // The last mode measures the overhead of collecting the timing statistics
+    const char* modes[] = {"polling", "event-driven", "timings"};
+    for (int mode = 0; mode < 3; ++mode) {
+      ThreadPool::Options options;
+      options.thread_count    = threads;
+      options.event_driven    = (mode > 0);
+      options.collect_timings = (mode == 2);
+      ThreadPool pool{options};
+
+      auto latencies  = measureLatency(pool, samples);
+      auto throughput = measureThroughput(pool, ntasks);
+
+      std::cout << std::setw(14) << modes[mode] << std::fixed << std::setprecision(1)
+                << std::setw(16) << latencies[latencies.size() / 2] << std::setw(16)
+                << latencies[latencies.size() * 99 / 100] << std::setw(16) << latencies.back() << std::setw(16)
+                << std::setprecision(0) << throughput << std::endl;
+      if (options.collect_timings) {
+        std::cout << std::endl << "Pool statistics: " << pool.statistics().toJson() << std::endl << std::endl;
+      }
+    }
+
+    {
+      ThreadPool::Options options;
+      options.thread_count = threads;
+      options.event_driven = true;
+      ThreadPool pool{options};
+      std::cout << std::endl
+                << "Heap allocations per task: " << std::setprecision(3) << measureAllocations(pool, 100000)
+                << std::endl;
+    }
+
+    std::cout << std::endl << "Scaling (event-driven, tasks/s)" << std::endl;
+    std::cout << std::setw(14) << "Scheduling" << std::setw(10) << "Threads" << std::setw(16) << "External"
+              << std::setw(16) << "Fan-out" << std::endl;
+    for (auto scheduling : {ThreadPool::Scheduling::Shared, ThreadPool::Scheduling::WorkStealing}) {
+      for (unsigned int n = 1; n <= threads; n = (n * 2 > threads && n != threads) ? threads : n * 2) {
+        ThreadPool::Options options;
+        options.thread_count = n;
+        options.event_driven = true;
+        options.scheduling   = scheduling;
+        ThreadPool pool{options};
+
+        auto external = measureThroughput(pool, ntasks);
+        auto fan_out  = measureFanOut(pool, ntasks, n);
+
+        std::cout << std::setw(14) << schedulingName(scheduling) << std::setw(10) << n << std::fixed
+                  << std::setprecision(0) << std::setw(16) << external << std::setw(16) << fan_out << std::endl;
+      }
+    }
+    return Elements::ExitCode::OK;
+  }
+};
+
+MAIN_FOR(ThreadPoolBenchmark)
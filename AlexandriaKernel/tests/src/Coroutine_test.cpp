@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file tests/src/Coroutine_test.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "AlexandriaKernel/Coroutine.h"
+
+#ifdef ALEXANDRIA_HAVE_COROUTINES
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Euclid;
+
+namespace {
+
+ThreadPool::Options poolOptions(unsigned int thread_count) {
+  ThreadPool::Options options;
+  options.thread_count = thread_count;
+  options.event_driven = true;
+  return options;
+}
+
+Coroutine<std::thread::id> threadOfPool(ThreadPool& pool) {
+  co_await pool.schedule();
+  co_return std::this_thread::get_id();
+}
+
+Coroutine<int> square(ThreadPool& pool, int value) {
+  co_await pool.schedule();
+  co_return value * value;
+}
+
+Coroutine<int> sumOfSquares(ThreadPool& pool, int n) {
+  int sum = 0;
+  for (int i = 1; i <= n; ++i) {
+    sum += co_await square(pool, i);
+  }
+  co_return sum;
+}
+
+Coroutine<int> failing(ThreadPool& pool) {
+  co_await pool.schedule();
+  throw std::runtime_error("failed");
+  co_return 0;
+}
+
+Coroutine<void> increment(ThreadPool& pool, std::atomic<int>& counter) {
+  co_await pool.schedule();
+  ++counter;
+}
+
+/// Reads a "chunk" on the I/O lane and processes it on the pool
+Coroutine<int> readAndProcess(IoLane& io, int chunk, std::set<std::thread::id>& io_threads, std::mutex& mutex) {
+  auto data = co_await io.run([chunk, &io_threads, &mutex]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    std::lock_guard<std::mutex> lock{mutex};
+    io_threads.insert(std::this_thread::get_id());
+    return std::vector<int>(10, chunk);
+  });
+  int sum = 0;
+  for (auto v : data) {
+    sum += v;
+  }
+  co_return sum;
+}
+
+}  // namespace
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(Coroutine_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(schedule_test) {
+
+  // Given
+  ThreadPool pool{poolOptions(2)};
+
+  // When
+  auto id = sync_wait(threadOfPool(pool));
+
+  // Then
+  BOOST_CHECK(id != std::this_thread::get_id());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(nested_test) {
+
+  // Given
+  ThreadPool pool{poolOptions(2)};
+
+  // When
+  auto result = sync_wait(sumOfSquares(pool, 10));
+
+  // Then
+  BOOST_CHECK_EQUAL(result, 385);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(exception_test) {
+
+  // Given
+  ThreadPool pool{poolOptions(2)};
+
+  // Then
+  BOOST_CHECK_THROW(sync_wait(failing(pool)), std::runtime_error);
+  BOOST_CHECK(!pool.checkForException());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(when_all_test) {
+
+  // Given
+  ThreadPool                  pool{poolOptions(4)};
+  std::vector<Coroutine<int>> coroutines;
+  for (int i = 0; i < 100; ++i) {
+    coroutines.push_back(square(pool, i));
+  }
+
+  // When
+  auto results = sync_wait(when_all(std::move(coroutines)));
+
+  // Then
+  BOOST_REQUIRE_EQUAL(results.size(), 100);
+  for (int i = 0; i < 100; ++i) {
+    BOOST_CHECK_EQUAL(results[i], i * i);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(when_all_void_test) {
+
+  // Given
+  ThreadPool                   pool{poolOptions(4)};
+  std::atomic<int>             counter{0};
+  std::vector<Coroutine<void>> coroutines;
+  for (int i = 0; i < 100; ++i) {
+    coroutines.push_back(increment(pool, counter));
+  }
+
+  // When
+  sync_wait(when_all(std::move(coroutines)));
+  sync_wait(when_all(std::vector<Coroutine<void>>{}));
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 100);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(when_all_exception_test) {
+
+  // Given
+  ThreadPool                  pool{poolOptions(2)};
+  std::vector<Coroutine<int>> coroutines;
+  coroutines.push_back(square(pool, 2));
+  coroutines.push_back(failing(pool));
+
+  // Then
+  BOOST_CHECK_THROW(sync_wait(when_all(std::move(coroutines))), std::runtime_error);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(io_lane_test) {
+
+  // Given
+  ThreadPool                  pool{poolOptions(2)};
+  IoLane                      io{pool};
+  std::set<std::thread::id>   io_threads;
+  std::mutex                  mutex;
+  std::vector<Coroutine<int>> coroutines;
+  for (int i = 0; i < 10; ++i) {
+    coroutines.push_back(readAndProcess(io, i, io_threads, mutex));
+  }
+
+  // When
+  auto results = sync_wait(when_all(std::move(coroutines)));
+
+  // Then
+  for (int i = 0; i < 10; ++i) {
+    BOOST_CHECK_EQUAL(results[i], 10 * i);
+  }
+  // All the reads happened on the single thread of the lane
+  BOOST_CHECK_EQUAL(io_threads.size(), 1);
+  BOOST_CHECK(io_threads.count(std::this_thread::get_id()) == 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#else
+
+BOOST_AUTO_TEST_CASE(coroutines_unsupported_test) {
+  BOOST_TEST_MESSAGE("The compiler does not support coroutines, nothing to test");
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file tests/src/Numa_test.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "AlexandriaKernel/Numa.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace Euclid;
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(Numa_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(topology_test) {
+  auto cpus = Numa::allowedCpus();
+  BOOST_REQUIRE(!cpus.empty());
+  BOOST_CHECK(std::is_sorted(cpus.begin(), cpus.end()));
+  BOOST_CHECK_GE(Numa::nodeCount(), 1);
+  for (auto cpu : cpus) {
+    BOOST_CHECK_GE(Numa::nodeOfCpu(cpu), 0);
+    BOOST_CHECK_LT(Numa::nodeOfCpu(cpu), Numa::nodeCount());
+  }
+  if (!Numa::available()) {
+    BOOST_CHECK_EQUAL(Numa::nodeCount(), 1);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(nodeOfAddress_test) {
+  std::vector<double> data(1 << 20, 1.);
+  int                 node = Numa::nodeOfAddress(data.data() + data.size() / 2);
+  if (Numa::available()) {
+    BOOST_CHECK_GE(node, 0);
+    BOOST_CHECK_LT(node, Numa::nodeCount());
+  } else {
+    BOOST_CHECK_EQUAL(node, -1);
+  }
+  BOOST_CHECK_EQUAL(Numa::nodeOfAddress(nullptr), -1);
+}
+
+//-----------------------------------------------------------------------------
+
+#ifdef __linux__
+BOOST_AUTO_TEST_CASE(pinCurrentThread_test) {
+  auto cpu    = Numa::allowedCpus().back();
+  bool pinned = false;
+  int  actual = -1;
+  // Use a separate thread, so the affinity of the test process is not changed
+  std::thread thread([cpu, &pinned, &actual]() {
+    pinned = Numa::pinCurrentThread(cpu);
+    actual = sched_getcpu();
+  });
+  thread.join();
+  BOOST_CHECK(pinned);
+  BOOST_CHECK_EQUAL(actual, static_cast<int>(cpu));
+}
+#endif
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file tests/src/Parallel_test.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include <atomic>
+#include <list>
+#include <numeric>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "AlexandriaKernel/Parallel.h"
+#include "ElementsKernel/Exception.h"
+
+using namespace Euclid;
+
+struct Parallel_Fixture {
+  ThreadPool pool{[]() {
+    ThreadPool::Options options;
+    options.thread_count = 4;
+    options.event_driven = true;
+    return options;
+  }()};
+};
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(Parallel_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(for_iterator_test, Parallel_Fixture) {
+
+  // Given
+  std::vector<int> values(1001, 1);
+
+  // When
+  parallel_for(pool, values.begin(), values.end(), 0, [](int& v) { v *= 2; });
+
+  // Then
+  for (auto v : values) {
+    BOOST_CHECK_EQUAL(v, 2);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(for_forward_iterator_test, Parallel_Fixture) {
+
+  // Given
+  std::list<int> values(333, 5);
+
+  // When
+  parallel_for(pool, values.begin(), values.end(), 10, [](int& v) { v += 1; });
+
+  // Then
+  for (auto v : values) {
+    BOOST_CHECK_EQUAL(v, 6);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(for_index_test, Parallel_Fixture) {
+
+  // Given
+  std::vector<std::size_t> values(1000);
+
+  // When
+  parallel_for(pool, std::size_t{0}, values.size(), 7, [&values](std::size_t i) { values[i] = i; });
+
+  // Then
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    BOOST_CHECK_EQUAL(values[i], i);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(for_empty_test, Parallel_Fixture) {
+
+  // Given
+  std::vector<int> values;
+  std::atomic<int> calls{0};
+
+  // When
+  parallel_for(pool, values.begin(), values.end(), 0, [&calls](int&) { ++calls; });
+  parallel_for(pool, 10, 5, 0, [&calls](int) { ++calls; });
+
+  // Then
+  BOOST_CHECK_EQUAL(calls, 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(for_exception_test, Parallel_Fixture) {
+
+  // When
+  BOOST_CHECK_THROW(parallel_for(pool, 0, 100, 1,
+                                 [](int i) {
+                                   if (i == 42) {
+                                     throw Elements::Exception();
+                                   }
+                                 }),
+                    Elements::Exception);
+
+  // Then
+  BOOST_CHECK(!pool.checkForException());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(reduce_test, Parallel_Fixture) {
+
+  // Given
+  std::vector<long> values(12345);
+  std::iota(values.begin(), values.end(), 0);
+
+  // When
+  auto sum = parallel_reduce(pool, values.begin(), values.end(), 0, 0L, [](long acc, long v) { return acc + v; },
+                             [](long a, long b) { return a + b; });
+
+  // Then
+  BOOST_CHECK_EQUAL(sum, 12345L * 12344L / 2);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(reduce_deterministic_test, Parallel_Fixture) {
+
+  // Given
+  std::vector<double> values(100000);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = 1. / (1. + i);
+  }
+  auto add = [](double a, double b) { return a + b; };
+
+  // When
+  auto first  = parallel_reduce(pool, values.begin(), values.end(), 0, 0., add, add);
+  auto second = parallel_reduce(pool, values.begin(), values.end(), 0, 0., add, add);
+
+  // Then
+  BOOST_CHECK_EQUAL(first, second);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(reduce_order_test, Parallel_Fixture) {
+
+  // Given
+  std::vector<int> values(100);
+  std::iota(values.begin(), values.end(), 0);
+
+  // When
+  auto concat = parallel_reduce(pool, values.begin(), values.end(), 3, std::vector<int>{},
+                                [](std::vector<int> acc, int v) {
+                                  acc.push_back(v);
+                                  return acc;
+                                },
+                                [](std::vector<int> a, const std::vector<int>& b) {
+                                  a.insert(a.end(), b.begin(), b.end());
+                                  return a;
+                                });
+
+  // Then
+  BOOST_CHECK_EQUAL_COLLECTIONS(concat.begin(), concat.end(), values.begin(), values.end());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(transform_test, Parallel_Fixture) {
+
+  // Given
+  std::vector<int> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  std::vector<int> output(values.size());
+
+  // When
+  auto end = parallel_transform(pool, values.begin(), values.end(), output.begin(), 0, [](int v) { return v * v; });
+
+  // Then
+  BOOST_CHECK(end == output.end());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    BOOST_CHECK_EQUAL(output[i], values[i] * values[i]);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(nested_test, Parallel_Fixture) {
+
+  // Given
+  std::vector<std::vector<int>> values(20, std::vector<int>(100, 1));
+
+  // When
+  parallel_for(pool, values.begin(), values.end(), 1, [this](std::vector<int>& row) {
+    parallel_for(pool, row.begin(), row.end(), 10, [](int& v) { v = 3; });
+  });
+
+  // Then
+  for (auto& row : values) {
+    for (auto v : row) {
+      BOOST_CHECK_EQUAL(v, 3);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(numa_pool_test) {
+
+  // Given
+  ThreadPool::Options options;
+  options.thread_count      = 4;
+  options.event_driven      = true;
+  options.affinity          = ThreadPool::Affinity::Compact;
+  options.numa_local_queues = true;
+  ThreadPool       pool{options};
+  std::vector<int> values(10000);
+  std::vector<int> doubled(values.size());
+
+  // When
+  // The first loop touches the memory, the rest follow it
+  parallel_for(pool, std::size_t{0}, values.size(), 0, [&values](std::size_t i) { values[i] = static_cast<int>(i); });
+  parallel_for(pool, values.begin(), values.end(), 0, [](int& v) { v += 1; });
+  auto sum = parallel_reduce(pool, values.begin(), values.end(), 0, 0L, [](long acc, int v) { return acc + v; },
+                             [](long a, long b) { return a + b; });
+  parallel_transform(pool, values.begin(), values.end(), doubled.begin(), 0, [](int v) { return 2 * v; });
+
+  // Then
+  BOOST_CHECK_EQUAL(sum, 10000L * 10001L / 2);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    BOOST_CHECK_EQUAL(doubled[i], 2 * static_cast<int>(i + 1));
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
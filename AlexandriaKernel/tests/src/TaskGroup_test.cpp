@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file tests/src/TaskGroup_test.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+#include "AlexandriaKernel/TaskGroup.h"
+#include "ElementsKernel/Exception.h"
+
+using namespace Euclid;
+
+namespace {
+
+ThreadPool::Options poolOptions(unsigned int thread_count, ThreadPool::Scheduling scheduling) {
+  ThreadPool::Options options;
+  options.thread_count = thread_count;
+  options.event_driven = true;
+  options.scheduling   = scheduling;
+  return options;
+}
+
+/// Computes the Fibonacci numbers recursively, waiting for the subproblems from inside the workers
+void fibonacci(ThreadPool& pool, int n, std::atomic<long>& result) {
+  if (n < 2) {
+    result += n;
+    return;
+  }
+  TaskGroup group{pool};
+  group.submit([&pool, &result, n]() { fibonacci(pool, n - 1, result); });
+  group.submit([&pool, &result, n]() { fibonacci(pool, n - 2, result); });
+  group.block();
+}
+
+}  // namespace
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(TaskGroup_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(block_test) {
+
+  // Given
+  std::atomic<int> counter{0};
+  ThreadPool       pool{poolOptions(4, ThreadPool::Scheduling::Shared)};
+  TaskGroup        group{pool};
+
+  // When
+  for (int i = 0; i < 1000; ++i) {
+    group.submit([&counter]() { ++counter; });
+  }
+  group.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 1000);
+  BOOST_CHECK_EQUAL(group.pending(), 0);
+  BOOST_CHECK(!group.checkForException());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(independent_test) {
+
+  // Given
+  std::atomic<bool> slow_done{false};
+  std::atomic<int>  counter{0};
+  ThreadPool        pool{poolOptions(2, ThreadPool::Scheduling::Shared)};
+  pool.submit([&slow_done]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    slow_done = true;
+  });
+
+  // When
+  TaskGroup group{pool};
+  for (int i = 0; i < 10; ++i) {
+    group.submit([&counter]() { ++counter; });
+  }
+  group.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 10);
+  BOOST_CHECK(!slow_done);
+  pool.block();
+  BOOST_CHECK(slow_done);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(nested_test) {
+  for (auto scheduling : {ThreadPool::Scheduling::Shared, ThreadPool::Scheduling::WorkStealing}) {
+    // Given
+    std::atomic<long> result{0};
+    ThreadPool        pool{poolOptions(2, scheduling)};
+
+    // When
+    TaskGroup group{pool};
+    group.submit([&pool, &result]() { fibonacci(pool, 15, result); });
+    group.block();
+
+    // Then
+    BOOST_CHECK_EQUAL(result, 610);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(submit_while_blocking_test) {
+
+  // Given
+  std::atomic<int> counter{0};
+  ThreadPool       pool{poolOptions(2, ThreadPool::Scheduling::Shared)};
+  TaskGroup        group{pool};
+
+  // When
+  group.submit([&group, &counter]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (int i = 0; i < 10; ++i) {
+      group.submit([&counter]() { ++counter; });
+    }
+  });
+  group.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 10);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(exception_test) {
+
+  // Given
+  ThreadPool pool{poolOptions(2, ThreadPool::Scheduling::Shared)};
+  TaskGroup  group{pool};
+
+  // When
+  group.submit([]() { throw Elements::Exception(); });
+
+  // Then
+  BOOST_CHECK_THROW(group.block(), Elements::Exception);
+  BOOST_CHECK(group.checkForException());
+  BOOST_CHECK(!pool.checkForException());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(failed_pool_test) {
+
+  // Given
+  std::atomic<int> counter{0};
+  ThreadPool       pool{poolOptions(2, ThreadPool::Scheduling::Shared)};
+  pool.submit([]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    throw Elements::Exception();
+  });
+
+  // When
+  TaskGroup group{pool};
+  for (int i = 0; i < 11; ++i) {
+    group.submit([&counter]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      ++counter;
+    });
+  }
+  // The pool fails while the group still has queued tasks, which its workers
+  // never start, so the blocking thread must run them
+  group.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 11);
+  BOOST_CHECK(!group.checkForException());
+  BOOST_CHECK(pool.checkForException());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(no_threads_test) {
+
+  // Given
+  std::atomic<int> counter{0};
+  ThreadPool       pool{0};
+  TaskGroup        group{pool};
+
+  // When
+  for (int i = 0; i < 10; ++i) {
+    group.submit([&counter]() { ++counter; });
+  }
+  group.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 10);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(cancel_test) {
+
+  // Given
+  std::promise<void> gate;
+  auto               gate_future = gate.get_future().share();
+  std::atomic<int>   counter{0};
+  ThreadPool         pool{poolOptions(1, ThreadPool::Scheduling::Shared)};
+  TaskGroup          group{pool};
+  TaskGroup          other{pool};
+  pool.submit([gate_future]() { gate_future.wait(); });
+  for (int i = 0; i < 10; ++i) {
+    group.submit([&counter]() { ++counter; });
+    other.submit([&counter]() { counter += 100; });
+  }
+
+  // When
+  group.cancel();
+  gate.set_value();
+  group.block();
+  other.block();
+
+  // Then
+  BOOST_CHECK(group.isCancelled());
+  BOOST_CHECK(!other.isCancelled());
+  BOOST_CHECK_EQUAL(counter, 1000);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(cooperative_cancel_test) {
+
+  // Given
+  std::atomic<int> started{0};
+  ThreadPool       pool{poolOptions(2, ThreadPool::Scheduling::Shared)};
+  TaskGroup        group{pool};
+  auto             token = group.token();
+
+  // When
+  for (int i = 0; i < 2; ++i) {
+    group.submit([&started, token]() {
+      ++started;
+      while (!token.isCancelled()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+  }
+  while (started < 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  group.cancel();
+  group.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(group.pending(), 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(shared_token_test) {
+
+  // Given
+  CancellationToken token;
+  std::atomic<int>  counter{0};
+  ThreadPool        pool{poolOptions(0, ThreadPool::Scheduling::Shared)};
+  TaskGroup         first{pool, token};
+  TaskGroup         second{pool, token};
+
+  // When
+  first.submit([&counter]() { ++counter; });
+  token.cancel();
+  second.submit([&counter]() { ++counter; });
+
+  // Then
+  BOOST_CHECK(first.isCancelled());
+  BOOST_CHECK(second.isCancelled());
+  BOOST_CHECK_EQUAL(counter, 1);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(pool_cancelAll_test) {
+
+  // Given
+  std::promise<void> gate;
+  auto               gate_future = gate.get_future().share();
+  std::atomic<int>   counter{0};
+  ThreadPool         pool{poolOptions(1, ThreadPool::Scheduling::WorkStealing)};
+  TaskGroup          group{pool};
+  pool.submit([gate_future]() { gate_future.wait(); });
+  while (pool.running() == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  for (int i = 0; i < 10; ++i) {
+    group.submit([&counter]() { ++counter; }, ThreadPool::Priority::Low);
+  }
+
+  // When
+  pool.cancelAll();
+  group.block();
+  gate.set_value();
+
+  // Then
+  BOOST_CHECK_EQUAL(group.pending(), 0);
+  BOOST_CHECK_EQUAL(counter, 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file tests/src/ThreadPoolStatistics_test.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+#include "AlexandriaKernel/ThreadPoolStatistics.h"
+
+using namespace Euclid;
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(ThreadPoolStatistics_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(binIndex_test) {
+  BOOST_CHECK_EQUAL(LatencyHistogram::binIndex(0), 0);
+  BOOST_CHECK_EQUAL(LatencyHistogram::binIndex(1), 0);
+  BOOST_CHECK_EQUAL(LatencyHistogram::binIndex(2), 1);
+  BOOST_CHECK_EQUAL(LatencyHistogram::binIndex(3), 1);
+  BOOST_CHECK_EQUAL(LatencyHistogram::binIndex(1024), 10);
+  BOOST_CHECK_EQUAL(LatencyHistogram::binIndex(UINT64_MAX), LatencyHistogram::BIN_COUNT - 1);
+  for (size_t bin = 1; bin < 20; ++bin) {
+    auto nanoseconds = static_cast<std::uint64_t>(LatencyHistogram::binLowerEdge(bin) * 1e9 + 0.5);
+    BOOST_CHECK_EQUAL(LatencyHistogram::binIndex(nanoseconds), bin);
+    BOOST_CHECK_CLOSE(LatencyHistogram::binUpperEdge(bin), 2 * LatencyHistogram::binLowerEdge(bin), 1e-10);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(percentile_test) {
+
+  // Given
+  LatencyHistogram histogram;
+  BOOST_CHECK_EQUAL(histogram.count(), 0);
+  BOOST_CHECK_EQUAL(histogram.percentile(0.5), 0);
+
+  // When
+  // 90 entries between 1.024us and 2.048us and 10 between 1.048ms and 2.097ms
+  histogram.add(10, 90);
+  histogram.add(20, 10);
+
+  // Then
+  BOOST_CHECK_EQUAL(histogram.count(), 100);
+  BOOST_CHECK_CLOSE(histogram.percentile(0.45), 1.024e-6 * 1.5, 1e-6);
+  BOOST_CHECK_CLOSE(histogram.percentile(0.9), 2.048e-6, 1e-6);
+  BOOST_CHECK_GT(histogram.percentile(0.91), 1.048e-3);
+  BOOST_CHECK_CLOSE(histogram.percentile(1.), LatencyHistogram::binUpperEdge(20), 1e-6);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(merge_test) {
+
+  // Given
+  LatencyHistogram first;
+  LatencyHistogram second;
+  first.add(3, 2);
+  second.add(3);
+  second.add(5, 4);
+
+  // When
+  first.merge(second);
+
+  // Then
+  BOOST_CHECK_EQUAL(first.count(), 7);
+  BOOST_CHECK_EQUAL(first.bins()[3], 3);
+  BOOST_CHECK_EQUAL(first.bins()[5], 4);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(utilization_test) {
+
+  // Given
+  ThreadPoolStatistics statistics;
+  statistics.uptime = 2;
+  statistics.workers.resize(2);
+  statistics.workers[0].busy_time = 2;
+  statistics.workers[1].busy_time = 1;
+
+  // Then
+  BOOST_CHECK_CLOSE(statistics.utilization(), 0.75, 1e-10);
+  BOOST_CHECK_EQUAL(ThreadPoolStatistics{}.utilization(), 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(toJson_test) {
+
+  // Given
+  ThreadPoolStatistics statistics;
+  statistics.timings_collected = true;
+  statistics.uptime            = 1;
+  statistics.tasks_executed    = 12;
+  statistics.tasks_stolen      = 3;
+  statistics.workers.resize(2);
+  statistics.workers[1].tasks_executed = 12;
+  statistics.workers[1].tasks_stolen   = 3;
+  statistics.task_duration.add(0, 12);
+
+  // When
+  auto json = statistics.toJson();
+
+  // Then
+  BOOST_CHECK_EQUAL(json.front(), '{');
+  BOOST_CHECK_EQUAL(json.back(), '}');
+  BOOST_CHECK(json.find("\"threads\": 2") != std::string::npos);
+  BOOST_CHECK(json.find("\"timings_collected\": true") != std::string::npos);
+  BOOST_CHECK(json.find("\"tasks_executed\": 12, \"tasks_stolen\": 3") != std::string::npos);
+  BOOST_CHECK(json.find("\"workers\": [{\"tasks_executed\": 0") != std::string::npos);
+  BOOST_CHECK(json.find("\"task_duration\": {\"count\": 12") != std::string::npos);
+  BOOST_CHECK(json.find("\"queue_wait\": {\"count\": 0") != std::string::npos);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
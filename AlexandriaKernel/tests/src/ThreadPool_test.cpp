@@ -22,16 +22,25 @@
  * @author nikoapos
  */
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <future>
 #include <mutex>
 #include <thread>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
 
+#include "AlexandriaKernel/Numa.h"
 #include "AlexandriaKernel/ThreadPool.h"
 #include "ElementsKernel/Exception.h"
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 using namespace Euclid;
 
 class SleepTask {
@@ -51,6 +60,27 @@ private:
   std::reference_wrapper<std::vector<int>> m_output;
 };
 
+ThreadPool::Options eventDrivenOptions(unsigned int thread_count) {
+  ThreadPool::Options options;
+  options.thread_count = thread_count;
+  // Make sure nothing relies on polling
+  options.empty_queue_wait_time = 10000;
+  options.event_driven          = true;
+  return options;
+}
+
+ThreadPool::Options workStealingOptions(unsigned int thread_count) {
+  auto options       = eventDrivenOptions(thread_count);
+  options.scheduling = ThreadPool::Scheduling::WorkStealing;
+  return options;
+}
+
+ThreadPool::Options boundedOptions(unsigned int thread_count, size_t capacity) {
+  auto options           = eventDrivenOptions(thread_count);
+  options.queue_capacity = capacity;
+  return options;
+}
+
 class ExceptionTask {
 
 public:
@@ -128,6 +158,51 @@ BOOST_AUTO_TEST_CASE(destructor_test) {
 
 //-----------------------------------------------------------------------------
 
+BOOST_AUTO_TEST_CASE(copyable_task_test) {
+
+  // Given
+  std::atomic<int>              counter{0};
+  ThreadPool                    pool{eventDrivenOptions(4)};
+  ThreadPool::Task              task = [&counter]() { ++counter; };
+  std::vector<ThreadPool::Task> tasks(3, task);
+
+  // When
+  std::vector<ThreadPool::Task> copies = tasks;
+  pool.submit(task);
+  for (auto& t : copies) {
+    pool.submit(t);
+  }
+  pool.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 4);
+  BOOST_CHECK(task);
+  BOOST_CHECK_EQUAL(tasks.size(), 3);
+  for (auto& t : copies) {
+    BOOST_CHECK(t);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(empty_task_test) {
+
+  // Given
+  ThreadPool pool{eventDrivenOptions(4)};
+  ThreadPool inline_pool{0};
+
+  // When
+  pool.submit(nullptr);
+
+  // Then
+  BOOST_CHECK_THROW(pool.block(), std::bad_function_call);
+  BOOST_CHECK(pool.checkForException());
+  BOOST_CHECK_THROW(inline_pool.submit(ThreadPool::Task{}), std::bad_function_call);
+  BOOST_CHECK_THROW(inline_pool.submit(UniqueTask{}), std::bad_function_call);
+}
+
+//-----------------------------------------------------------------------------
+
 BOOST_AUTO_TEST_CASE(block_exception_test) {
 
   // Given
@@ -159,4 +234,565 @@ BOOST_AUTO_TEST_CASE(checkForException_test) {
 
 //-----------------------------------------------------------------------------
 
+BOOST_AUTO_TEST_CASE(event_driven_block_test) {
+
+  // Given
+  std::mutex       mutex;
+  std::vector<int> output{};
+  ThreadPool       pool{eventDrivenOptions(4)};
+
+  // When
+  pool.submit(SleepTask(1000, mutex, output));
+  pool.submit(SleepTask(700, mutex, output));
+  pool.submit(SleepTask(900, mutex, output));
+  pool.submit(SleepTask(500, mutex, output));
+  pool.submit(SleepTask(350, mutex, output));
+  pool.submit(SleepTask(100, mutex, output));
+  pool.block();
+
+  // Then
+  std::lock_guard<std::mutex> lock{mutex};
+  BOOST_CHECK(!pool.checkForException());
+  BOOST_CHECK_EQUAL(output.size(), 6);
+  BOOST_CHECK_EQUAL(output[0], 500);
+  BOOST_CHECK_EQUAL(output[1], 700);
+  BOOST_CHECK_EQUAL(output[2], 100);
+  BOOST_CHECK_EQUAL(output[3], 350);
+  BOOST_CHECK_EQUAL(output[4], 900);
+  BOOST_CHECK_EQUAL(output[5], 1000);
+  BOOST_CHECK_EQUAL(pool.queued(), 0);
+  BOOST_CHECK_EQUAL(pool.running(), 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(event_driven_wakeup_test) {
+
+  // Given
+  std::atomic<int> counter{0};
+  ThreadPool       pool{eventDrivenOptions(2)};
+  // Let the workers go idle
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // When
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 1000; ++i) {
+    pool.submit([&counter]() { ++counter; });
+  }
+  pool.block();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 1000);
+  BOOST_CHECK_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 5000);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(event_driven_destructor_test) {
+
+  // Given
+  std::mutex       mutex;
+  std::vector<int> output{};
+
+  // When
+  auto start = std::chrono::steady_clock::now();
+  {
+    ThreadPool pool{eventDrivenOptions(2)};
+    pool.submit(SleepTask(300, mutex, output));
+    pool.submit(SleepTask(100, mutex, output));
+    pool.submit(SleepTask(100, mutex, output));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // Then
+  std::lock_guard<std::mutex> lock{mutex};
+  BOOST_CHECK_EQUAL(output.size(), 2);
+  BOOST_CHECK_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 5000);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(event_driven_exception_test) {
+
+  // Given
+  ThreadPool pool{eventDrivenOptions(4)};
+
+  // When
+  pool.submit(ExceptionTask());
+
+  // Then
+  BOOST_CHECK_THROW(pool.block(), Elements::Exception);
+  BOOST_CHECK(pool.checkForException());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(work_stealing_block_test) {
+
+  // Given
+  std::atomic<int> counter{0};
+  ThreadPool       pool{workStealingOptions(4)};
+
+  // When
+  for (int i = 0; i < 10000; ++i) {
+    pool.submit([&counter]() { ++counter; });
+  }
+  pool.block();
+
+  // Then
+  BOOST_CHECK(!pool.checkForException());
+  BOOST_CHECK_EQUAL(counter, 10000);
+  BOOST_CHECK_EQUAL(pool.queued(), 0);
+  BOOST_CHECK_EQUAL(pool.running(), 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(work_stealing_nested_submit_test) {
+
+  // Given
+  std::atomic<int> counter{0};
+  ThreadPool       pool{workStealingOptions(4)};
+
+  // When
+  for (int i = 0; i < 100; ++i) {
+    pool.submit([&pool, &counter]() {
+      for (int j = 0; j < 100; ++j) {
+        pool.submit([&counter]() { ++counter; });
+      }
+    });
+  }
+  pool.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 10000);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(work_stealing_steal_test) {
+
+  // Given
+  std::mutex       mutex;
+  std::vector<int> output{};
+  ThreadPool       pool{workStealingOptions(2)};
+
+  // When
+  // All the sleeping tasks end up in the queue of the worker running the first
+  // task, so the other worker has to steal them
+  pool.submit([&pool, &mutex, &output]() {
+    for (int i = 0; i < 4; ++i) {
+      pool.submit(SleepTask(200, mutex, output));
+    }
+  });
+  auto start = std::chrono::steady_clock::now();
+  pool.block();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // Then
+  BOOST_CHECK_EQUAL(output.size(), 4);
+  BOOST_CHECK_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 700);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(work_stealing_exception_test) {
+
+  // Given
+  ThreadPool pool{workStealingOptions(4)};
+
+  // When
+  pool.submit(ExceptionTask());
+
+  // Then
+  BOOST_CHECK_THROW(pool.block(), Elements::Exception);
+  BOOST_CHECK(pool.checkForException());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(future_test) {
+
+  // Given
+  ThreadPool                    pool{eventDrivenOptions(4)};
+  std::vector<std::future<int>> futures;
+
+  // When
+  for (int i = 0; i < 100; ++i) {
+    futures.emplace_back(pool.submitWithResult([i]() { return i * i; }));
+  }
+
+  // Then
+  for (int i = 0; i < 100; ++i) {
+    BOOST_CHECK_EQUAL(futures[i].get(), i * i);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(future_exception_test) {
+
+  // Given
+  ThreadPool pool{eventDrivenOptions(4)};
+
+  // When
+  auto future = pool.submitWithResult([]() -> int { throw Elements::Exception(); });
+
+  // Then
+  BOOST_CHECK_THROW(future.get(), Elements::Exception);
+  pool.block();
+  BOOST_CHECK(!pool.checkForException());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(value_returning_submit_exception_test) {
+
+  // Given
+  ThreadPool pool{eventDrivenOptions(4)};
+
+  // When
+  pool.submit([]() -> int { throw Elements::Exception(); });
+
+  // Then
+  BOOST_CHECK_THROW(pool.block(), Elements::Exception);
+  BOOST_CHECK(pool.checkForException());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(bounded_block_test) {
+
+  // Given
+  std::mutex       mutex;
+  std::vector<int> output{};
+  ThreadPool       pool{boundedOptions(2, 3)};
+
+  // When
+  for (int i = 0; i < 20; ++i) {
+    pool.submit(SleepTask(10, mutex, output));
+    BOOST_CHECK_LE(pool.queued(), 3);
+  }
+  pool.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(output.size(), 20);
+  BOOST_CHECK_EQUAL(pool.queueCapacity(), 3);
+  BOOST_CHECK_EQUAL(pool.queuedHighWaterMark(), 3);
+  BOOST_CHECK_EQUAL(pool.runningHighWaterMark(), 2);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(bounded_try_submit_test) {
+
+  // Given
+  std::promise<void> gate;
+  auto               gate_future = gate.get_future().share();
+  std::atomic<int>   counter{0};
+  ThreadPool         pool{boundedOptions(1, 1)};
+  pool.submit([gate_future]() { gate_future.wait(); });
+  while (pool.running() == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // When
+  auto task   = [&counter]() { ++counter; };
+  bool first  = pool.trySubmit(task);
+  bool second = pool.trySubmit(task);
+  gate.set_value();
+  pool.block();
+  bool third = pool.trySubmit(task);
+  pool.block();
+
+  // Then
+  BOOST_CHECK(first);
+  BOOST_CHECK(!second);
+  BOOST_CHECK(third);
+  BOOST_CHECK_EQUAL(counter, 2);
+  BOOST_CHECK_EQUAL(pool.queuedHighWaterMark(), 1);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(bounded_nested_submit_test) {
+  for (auto scheduling : {ThreadPool::Scheduling::Shared, ThreadPool::Scheduling::WorkStealing}) {
+    // Given
+    std::atomic<int> counter{0};
+    auto             options = boundedOptions(2, 2);
+    options.scheduling       = scheduling;
+    ThreadPool pool{options};
+
+    // When
+    for (int i = 0; i < 10; ++i) {
+      pool.submit([&pool, &counter]() {
+        for (int j = 0; j < 10; ++j) {
+          pool.submit([&counter]() { ++counter; });
+        }
+      });
+    }
+    pool.block();
+
+    // Then
+    BOOST_CHECK_EQUAL(counter, 100);
+    BOOST_CHECK_LE(pool.queuedHighWaterMark(), 2);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(statistics_counters_test) {
+
+  // Given
+  std::atomic<int> counter{0};
+  ThreadPool       pool{eventDrivenOptions(2)};
+
+  // When
+  for (int i = 0; i < 100; ++i) {
+    pool.submit([&counter]() { ++counter; });
+  }
+  pool.block();
+  auto statistics = pool.statistics();
+
+  // Then
+  BOOST_CHECK_EQUAL(counter, 100);
+  BOOST_CHECK(!statistics.timings_collected);
+  BOOST_CHECK_EQUAL(statistics.tasks_executed, 100);
+  BOOST_CHECK_EQUAL(statistics.tasks_stolen, 0);
+  BOOST_CHECK_EQUAL(statistics.queued, 0);
+  BOOST_CHECK_EQUAL(statistics.running, 0);
+  BOOST_REQUIRE_EQUAL(statistics.workers.size(), 2);
+  BOOST_CHECK_EQUAL(statistics.workers[0].tasks_executed + statistics.workers[1].tasks_executed, 100);
+  BOOST_CHECK_EQUAL(statistics.queue_wait.count(), 0);
+  BOOST_CHECK_EQUAL(statistics.task_duration.count(), 0);
+  BOOST_CHECK_GT(statistics.uptime, 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(statistics_timings_test) {
+
+  // Given
+  std::mutex       mutex;
+  std::vector<int> output{};
+  auto             options = eventDrivenOptions(1);
+  options.collect_timings  = true;
+  ThreadPool pool{options};
+
+  // When
+  for (int i = 0; i < 5; ++i) {
+    pool.submit(SleepTask(10, mutex, output));
+  }
+  pool.block();
+  auto statistics = pool.statistics();
+
+  // Then
+  BOOST_CHECK(statistics.timings_collected);
+  BOOST_CHECK_EQUAL(statistics.tasks_executed, 5);
+  BOOST_CHECK_EQUAL(statistics.queue_wait.count(), 5);
+  BOOST_CHECK_EQUAL(statistics.task_duration.count(), 5);
+  // The histogram bins are a factor of two wide
+  BOOST_CHECK_GE(statistics.task_duration.percentile(0.5), 0.005);
+  BOOST_CHECK_GE(statistics.workers[0].busy_time, 0.05);
+  // The last task waited for the four before it
+  BOOST_CHECK_GE(statistics.queue_wait.percentile(1.), 0.02);
+  BOOST_CHECK_GT(statistics.utilization(), 0);
+  BOOST_CHECK_LE(statistics.utilization(), 1);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(statistics_steal_test) {
+
+  // Given
+  std::mutex       mutex;
+  std::vector<int> output{};
+  ThreadPool       pool{workStealingOptions(2)};
+
+  // When
+  pool.submit([&pool, &mutex, &output]() {
+    for (int i = 0; i < 4; ++i) {
+      pool.submit(SleepTask(50, mutex, output));
+    }
+  });
+  pool.block();
+  auto statistics = pool.statistics();
+
+  // Then
+  BOOST_CHECK_EQUAL(statistics.tasks_executed, 5);
+  BOOST_CHECK_GE(statistics.tasks_stolen, 1);
+  BOOST_CHECK_EQUAL(statistics.workers[0].tasks_stolen + statistics.workers[1].tasks_stolen,
+                    statistics.tasks_stolen);
+}
+
+//-----------------------------------------------------------------------------
+
+#ifdef __linux__
+BOOST_AUTO_TEST_CASE(affinity_cores_test) {
+
+  // Given
+  auto             cpu     = Numa::allowedCpus().front();
+  auto             options = eventDrivenOptions(2);
+  options.cores            = {cpu};
+  std::mutex       mutex;
+  std::vector<int> cpus;
+  ThreadPool       pool{options};
+
+  // When
+  for (int i = 0; i < 20; ++i) {
+    pool.submit([&mutex, &cpus]() {
+      std::lock_guard<std::mutex> lock{mutex};
+      cpus.push_back(sched_getcpu());
+    });
+  }
+  pool.block();
+
+  // Then
+  BOOST_REQUIRE_EQUAL(cpus.size(), 20);
+  for (auto c : cpus) {
+    BOOST_CHECK_EQUAL(c, static_cast<int>(cpu));
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(affinity_policy_test) {
+  auto allowed = Numa::allowedCpus();
+  for (auto affinity : {ThreadPool::Affinity::Compact, ThreadPool::Affinity::Scatter}) {
+    // Given
+    auto options     = eventDrivenOptions(static_cast<unsigned int>(allowed.size()) + 1);
+    options.affinity = affinity;
+    std::mutex       mutex;
+    std::vector<int> cpus;
+    ThreadPool       pool{options};
+
+    // When
+    for (int i = 0; i < 20; ++i) {
+      pool.submit([&mutex, &cpus]() {
+        std::lock_guard<std::mutex> lock{mutex};
+        cpus.push_back(sched_getcpu());
+      });
+    }
+    pool.block();
+
+    // Then
+    BOOST_REQUIRE_EQUAL(cpus.size(), 20);
+    for (auto c : cpus) {
+      BOOST_CHECK(std::find(allowed.begin(), allowed.end(), static_cast<unsigned int>(c)) != allowed.end());
+    }
+  }
+}
+#endif
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(numa_queues_test) {
+  for (auto scheduling : {ThreadPool::Scheduling::Shared, ThreadPool::Scheduling::WorkStealing}) {
+    // Given
+    auto options              = eventDrivenOptions(4);
+    options.scheduling        = scheduling;
+    options.affinity          = ThreadPool::Affinity::Scatter;
+    options.numa_local_queues = true;
+    std::atomic<int> counter{0};
+    ThreadPool       pool{options};
+    auto&            nodes = pool.numaNodes();
+
+    // When
+    // Submit to the nodes of the pool, to unknown nodes and to any node
+    std::vector<int> targets(nodes.begin(), nodes.end());
+    targets.push_back(-1);
+    targets.push_back(Numa::nodeCount() + 1);
+    for (int i = 0; i < 100; ++i) {
+      pool.submitToNode([&counter]() { ++counter; }, targets[i % targets.size()]);
+    }
+    pool.block();
+
+    // Then
+    BOOST_CHECK(nodes.empty() || nodes.size() >= 2);
+    BOOST_CHECK(std::is_sorted(nodes.begin(), nodes.end()));
+    BOOST_CHECK_EQUAL(counter, 100);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(priority_test) {
+  for (auto scheduling : {ThreadPool::Scheduling::Shared, ThreadPool::Scheduling::WorkStealing}) {
+    // Given
+    std::promise<void> gate;
+    auto               gate_future = gate.get_future().share();
+    std::mutex         mutex;
+    std::vector<int>   output;
+    auto               options = eventDrivenOptions(1);
+    options.scheduling         = scheduling;
+    ThreadPool pool{options};
+    pool.submit([gate_future]() { gate_future.wait(); });
+    while (pool.running() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // When
+    // The tasks record 10 * priority + submission order
+    for (int i = 0; i < 9; ++i) {
+      int  priority = i % 3;
+      auto task     = [&mutex, &output, priority, i]() {
+        std::lock_guard<std::mutex> lock{mutex};
+        output.push_back(10 * priority + i / 3);
+      };
+      pool.submit(task, static_cast<ThreadPool::Priority>(priority));
+    }
+    gate.set_value();
+    pool.block();
+
+    // Then
+    std::vector<int> expected;
+    if (scheduling == ThreadPool::Scheduling::Shared) {
+      expected = {20, 21, 22, 10, 11, 12, 0, 1, 2};
+    } else {
+      // The worker runs its own tasks in LIFO order
+      expected = {22, 21, 20, 12, 11, 10, 2, 1, 0};
+    }
+    BOOST_CHECK_EQUAL_COLLECTIONS(output.begin(), output.end(), expected.begin(), expected.end());
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(cancelAll_test) {
+
+  // Given
+  std::promise<void> gate;
+  auto               gate_future = gate.get_future().share();
+  std::atomic<int>   counter{0};
+  ThreadPool         pool{eventDrivenOptions(1)};
+  pool.submit([gate_future]() { gate_future.wait(); });
+  while (pool.running() == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  for (int i = 0; i < 10; ++i) {
+    pool.submit([&counter]() { ++counter; }, ThreadPool::Priority::High);
+  }
+  auto future = pool.submitWithResult([]() { return 42; });
+
+  // When
+  auto cancelled = pool.cancelAll();
+  gate.set_value();
+  pool.block();
+
+  // Then
+  BOOST_CHECK_EQUAL(cancelled, 11);
+  BOOST_CHECK_EQUAL(counter, 0);
+  BOOST_CHECK_EQUAL(pool.queued(), 0);
+  BOOST_CHECK_THROW(future.get(), std::future_error);
+
+  // The pool is still usable
+  pool.submit([&counter]() { ++counter; });
+  pool.block();
+  BOOST_CHECK_EQUAL(counter, 1);
+}
+
+//-----------------------------------------------------------------------------
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file tests/src/UniqueTask_test.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include <array>
+#include <functional>
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+#include "AlexandriaKernel/UniqueTask.h"
+
+using namespace Euclid;
+
+/// Counts how many instances are alive, to detect leaks and double destructions
+struct CountedTask {
+  static int alive;
+
+  explicit CountedTask(int& calls) : m_calls(&calls) {
+    ++alive;
+  }
+  CountedTask(const CountedTask& other) : m_calls(other.m_calls) {
+    ++alive;
+  }
+  CountedTask(CountedTask&& other) noexcept : m_calls(other.m_calls) {
+    ++alive;
+  }
+  ~CountedTask() {
+    --alive;
+  }
+  void operator()() {
+    ++(*m_calls);
+  }
+
+  int* m_calls;
+};
+
+int CountedTask::alive = 0;
+
+/// Too big to be stored inline
+struct BigTask : public CountedTask {
+  explicit BigTask(int& calls) : CountedTask(calls), m_padding{} {}
+  std::array<char, UniqueTask::INLINE_SIZE> m_padding;
+};
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(UniqueTask_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(empty_test) {
+  UniqueTask task;
+  BOOST_CHECK(!task);
+  BOOST_CHECK(!task.isInline());
+  BOOST_CHECK_THROW(task(), std::bad_function_call);
+  task = nullptr;
+  BOOST_CHECK(!task);
+  BOOST_CHECK_THROW(task(), std::bad_function_call);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(inline_test) {
+
+  // Given
+  int calls = 0;
+
+  // When
+  {
+    UniqueTask task{CountedTask{calls}};
+    BOOST_CHECK(task);
+    BOOST_CHECK(task.isInline());
+    BOOST_CHECK_EQUAL(CountedTask::alive, 1);
+    task();
+    task();
+  }
+
+  // Then
+  BOOST_CHECK_EQUAL(calls, 2);
+  BOOST_CHECK_EQUAL(CountedTask::alive, 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(heap_test) {
+
+  // Given
+  int calls = 0;
+
+  // When
+  {
+    UniqueTask task{BigTask{calls}};
+    BOOST_CHECK(task);
+    BOOST_CHECK(!task.isInline());
+    BOOST_CHECK_EQUAL(CountedTask::alive, 1);
+    task();
+  }
+
+  // Then
+  BOOST_CHECK_EQUAL(calls, 1);
+  BOOST_CHECK_EQUAL(CountedTask::alive, 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(move_test) {
+  int calls = 0;
+  for (bool big : {false, true}) {
+    // Given
+    UniqueTask first = big ? UniqueTask{BigTask{calls}} : UniqueTask{CountedTask{calls}};
+
+    // When
+    UniqueTask second{std::move(first)};
+    UniqueTask third;
+    third = std::move(second);
+
+    // Then
+    BOOST_CHECK(!first);
+    BOOST_CHECK(!second);
+    BOOST_CHECK(third);
+    BOOST_CHECK_EQUAL(CountedTask::alive, 1);
+    third();
+    third = nullptr;
+    BOOST_CHECK_EQUAL(CountedTask::alive, 0);
+  }
+  BOOST_CHECK_EQUAL(calls, 2);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(move_only_test) {
+
+  // Given
+  std::unique_ptr<int> value{new int{0}};
+  int*                 raw = value.get();
+  std::function<void(std::unique_ptr<int>&)> increment = [](std::unique_ptr<int>& v) { ++(*v); };
+
+  // When
+  UniqueTask task{std::bind(increment, std::move(value))};
+  task();
+
+  // Then
+  BOOST_CHECK_EQUAL(*raw, 1);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(function_test) {
+
+  // Given
+  int                   calls = 0;
+  std::function<void()> function{CountedTask{calls}};
+
+  // When
+  UniqueTask task{function};
+  task();
+  function();
+
+  // Then
+  BOOST_CHECK_EQUAL(calls, 2);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -22,6 +22,7 @@
  * @author Nikolaos Apostolakos
  */
 
+#include "AlexandriaKernel/Parallel.h"
 #include "GridContainer/GridContainer.h"
 #include <ElementsKernel/Real.h>
 #include <boost/test/test_tools.hpp>
@@ -1053,4 +1054,23 @@ BOOST_FIXTURE_TEST_CASE(infimumGrid, GridContainer_Fixture) {
 
 //-----------------------------------------------------------------------------
 
+BOOST_FIXTURE_TEST_CASE(parallelIteration, GridContainer_Fixture) {
+  // Given
+  Euclid::ThreadPool pool{4};
+  GridContainerType  grid{axes_tuple};
+
+  // When
+  Euclid::parallel_for(pool, grid.begin(), grid.end(), 5, [](double& cell) { cell = 2.; });
+  auto sum = Euclid::parallel_reduce(pool, grid.begin(), grid.end(), 0, 0., [](double acc, double v) { return acc + v; },
+                                     [](double a, double b) { return a + b; });
+
+  // Then
+  for (auto& cell : grid) {
+    BOOST_CHECK_EQUAL(cell, 2.);
+  }
+  BOOST_CHECK_EQUAL(sum, 2. * total_size);
+}
+
+//-----------------------------------------------------------------------------
+
 BOOST_AUTO_TEST_SUITE_END()
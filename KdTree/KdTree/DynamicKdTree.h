@@ -0,0 +1,161 @@
+/** Copyright © 2021 Université de Genève, LMU Munich - Faculty of Physics, IAP-CNRS/Sorbonne Université
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _SEUTILS_DYNAMICKDTREE_H_
+#define _SEUTILS_DYNAMICKDTREE_H_
+
+#include <vector>
+#include <memory>
+#include <unordered_set>
+
+#include "KdTree/KdTree.h"
+
+namespace KdTree {
+
+namespace DynamicKdTree_Impl {
+
+/// A point of a DynamicKdTree, with the identifier returned by insert()
+template<typename T>
+struct Entry {
+  T point;
+  size_t id;
+};
+
+}  // namespace DynamicKdTree_Impl
+
+template<typename T>
+struct KdTreeTraits<DynamicKdTree_Impl::Entry<T>> {
+  static double getCoord(const DynamicKdTree_Impl::Entry<T>& entry, size_t index) {
+    return KdTreeTraits<T>::getCoord(entry.point, index);
+  }
+};
+
+/**
+ * @class DynamicKdTree
+ * @brief A KdTree supporting insertions and deletions
+ *
+ * The points are kept in a forest of static KdTree's (the logarithmic method): the tree of
+ * level i holds at most B * 2^i points, with B = S, and the last inserted points wait in a
+ * buffer of at most B points, which the queries scan directly. When the buffer is full, it is
+ * merged with the consecutive occupied levels starting from the first one, and the result is
+ * built as a single tree in the first free level, like a carry in a binary counter. Every point
+ * is then rebuilt O(log n) times, and the queries visit O(log n) trees.
+ *
+ * Erased points are only marked as deleted, the queries skip them and the merges drop them.
+ * When the deleted points outnumber the live ones, all the live points are rebuilt in a single
+ * tree, so the memory and the query cost stay proportional to the number of live points. The
+ * identifiers are never reused, and only the ones of the live points are remembered.
+ *
+ * The coordinates of the points are read with KdTreeTraits<T>, as for KdTree.
+ */
+template<typename T, size_t N=2, size_t S=100>
+class DynamicKdTree {
+public:
+  using Tree = KdTree<DynamicKdTree_Impl::Entry<T>, N, S>;
+  using Coord = typename Tree::Coord;
+  using Neighbor = typename KdTree<T, N, S>::Neighbor;
+
+  /// Creates an empty tree
+  DynamicKdTree() = default;
+
+  /// Creates an empty tree, building the big merged trees with the given pool
+  explicit DynamicKdTree(Euclid::ThreadPool& pool);
+
+  /**
+   * Adds a point to the tree
+   * @return
+   *    The identifier of the point, to be passed to erase()
+   */
+  size_t insert(const T& point);
+
+  /**
+   * Removes a point from the tree
+   * @return
+   *    False if there is no point with this identifier (it was never returned
+   *    by insert(), or it has already been erased)
+   */
+  bool erase(size_t id);
+
+  /// Returns true if the point with the given identifier is in the tree
+  bool contains(size_t id) const;
+
+  /// Returns the points closer than radius to coord
+  std::vector<T> findPointsWithinRadius(Coord coord, double radius) const;
+
+  /// Calls visitor with a const reference to every point closer than radius to coord
+  template<typename Visitor>
+  void forEachPointWithinRadius(Coord coord, double radius, Visitor&& visitor) const;
+
+  /// Returns the number of points closer than radius to coord
+  size_t countPointsWithinRadius(Coord coord, double radius) const;
+
+  /// Returns the points inside an axis aligned box, faces included
+  std::vector<T> findPointsInBox(Coord min, Coord max) const;
+
+  /**
+   * Finds the k points closest to the given coordinates
+   * @return
+   *    The neighbours sorted by increasing distance. If the tree has fewer
+   *    than k points, all of them are returned.
+   */
+  std::vector<Neighbor> findNearest(Coord coord, size_t k) const;
+
+  /// Returns the number of points in the tree
+  size_t size() const;
+
+private:
+  using Entry = DynamicKdTree_Impl::Entry<T>;
+
+  /// Returns the maximum number of points of the tree at the given level
+  static size_t capacity(size_t level);
+
+  /// Returns the squared distance between coord and the given point
+  static double squareDistance(const Coord& coord, const T& point);
+
+  /// Moves the live points of the given level to entries, leaving the level empty
+  void collect(size_t level, std::vector<Entry>& entries);
+
+  /// Builds a tree with the given entries at the given level
+  void place(size_t level, std::vector<Entry>&& entries);
+
+  /// Merges the buffer with the lower levels
+  void flush();
+
+  /// Rebuilds all the live points in a single tree
+  void compact();
+
+  /// Returns false if the entry has been erased
+  bool isLive(const Entry& entry) const;
+
+  Euclid::ThreadPool* m_pool = nullptr;
+  /// The last inserted points, not yet in a tree
+  std::vector<Entry> m_buffer;
+  /// The tree of each level, or null for the empty levels
+  std::vector<std::unique_ptr<Tree>> m_levels;
+  /// The identifiers of the live points
+  std::unordered_set<size_t> m_live_ids;
+  /// The identifier of the next inserted point
+  size_t m_next_id = 0;
+  /// The number of erased points still stored in the buffer or the trees
+  size_t m_erased = 0;
+};
+
+}  // namespace KdTree
+
+#include "_impl/DynamicKdTree.icpp"
+
+#endif /* _SEUTILS_DYNAMICKDTREE_H_ */
@@ -21,6 +21,23 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <utility>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "KdTree/LeafScan.h"
+#include "AlexandriaKernel/TaskGroup.h"
+#include "AlexandriaKernel/ThreadPool.h"
+#include "ElementsKernel/Exception.h"
 
 namespace KdTree {
 
@@ -29,6 +46,9 @@ struct KdTreeTraits {
   static double getCoord(const T& t, size_t index);
 };
 
+template<typename T, size_t N, size_t S>
+class DynamicKdTree;
+
 /**
  * @class KdTree
  * @brief A simple N-dimensional KdTree for speeding-up elements within range types of queries.
@@ -36,6 +56,23 @@ struct KdTreeTraits {
  * template arguments: T type, a traits implementation to access coordinates must be provided
  *                     N number of dimensions
  *                     S maximum number of elements in leaf nodes (must be >= 4, in practice we want larger anyway)
+ *
+ * The tree is stored in flat arrays: the nodes are kept in depth-first order in a single vector
+ * (the left child of a split follows it directly, the right child is referenced by index) and the
+ * points are copied once, in tree order, in a single contiguous buffer. Every node covers a
+ * contiguous range of this buffer, so the leaves are just index ranges and the queries do not
+ * chase any pointers. The coordinates are also stored separately, in one array per dimension,
+ * and the leaves are scanned with the SIMD kernels of scanLeaf(), which compute the distances
+ * of several points at once. The leaves can then be much bigger than the default S.
+ *
+ * The tree is built by partitioning with std::nth_element an array of indices to the input points,
+ * each carrying a copy of the point coordinates, so the points themselves are copied only once
+ * and the build is O(n log n). When a ThreadPool is given, the subtrees bigger than a threshold
+ * are built concurrently. The resulting tree does not depend on the number of threads.
+ *
+ * Every node also keeps the bounding box of its points. The dual-tree algorithms (pair counting
+ * and friends-of-friends grouping) use the distance bounds between two boxes to discard, or to
+ * accept in a single step, whole pairs of subtrees.
  */
 
 template<typename T, size_t N=2, size_t S=100>
@@ -47,15 +84,297 @@ public:
     double coord[N];
   };
 
+  /**
+   * The results of a batch of queries, in compressed sparse row format. The points found by
+   * the query i are the indices[offsets[i]] to indices[offsets[i + 1] - 1], where each index
+   * is the position of the point in the vector the tree was built from.
+   */
+  struct BatchResult {
+    std::vector<size_t> offsets;
+    std::vector<size_t> indices;
+  };
+
+  /// A point returned by the nearest neighbour queries, with its distance to the query coordinates
+  struct Neighbor {
+    T point;
+    double distance;
+  };
+
   explicit KdTree(const std::vector<T>& data);
+
+  /**
+   * Builds the tree using the given pool
+   * @param data
+   *    The points of the tree
+   * @param pool
+   *    The pool building the subtrees concurrently
+   * @param parallel_threshold
+   *    Subtrees with fewer points than this are built by a single task
+   */
+  KdTree(const std::vector<T>& data, Euclid::ThreadPool& pool, size_t parallel_threshold = 1 << 16);
   std::vector<T> findPointsWithinRadius(Coord coord, double radius) const;
 
+  /**
+   * Same as above, but clears the given buffer and fills it with the points found,
+   * so a buffer reused over many queries stops allocating once it is large enough
+   */
+  void findPointsWithinRadius(Coord coord, double radius, std::vector<T>& buffer) const;
+
+  /**
+   * Copies the points closer than radius to coord in the given output iterator
+   * @return
+   *    The output iterator past the last copied point
+   */
+  template<typename OutputIterator>
+  OutputIterator findPointsWithinRadius(Coord coord, double radius, OutputIterator out) const;
+
+  /**
+   * Calls visitor with a const reference to every point closer than radius to coord.
+   * The points are not copied and the query does not allocate any memory.
+   */
+  template<typename Visitor>
+  void forEachPointWithinRadius(Coord coord, double radius, Visitor&& visitor) const;
+
+  /// Returns the number of points closer than radius to coord, without copying them
+  size_t countPointsWithinRadius(Coord coord, double radius) const;
+
+  /**
+   * Finds the points inside an axis aligned box
+   * @param min
+   *    The minimum coordinates of the box
+   * @param max
+   *    The maximum coordinates of the box. The points on the faces of the box
+   *    are inside it.
+   */
+  std::vector<T> findPointsInBox(Coord min, Coord max) const;
+
+  /**
+   * Runs a radius query for each of the given coordinates, in parallel
+   * @details
+   * The queries are sorted along a Morton curve before they are split in tasks,
+   * so consecutive queries of a task visit mostly the same nodes. The results
+   * do not depend on the number of threads.
+   * @param coords
+   *    The centers of the queries
+   * @param radii
+   *    The radius of each query
+   * @param pool
+   *    The pool executing the queries
+   * @throws Elements::Exception
+   *    If the number of radii is not the same as the number of coordinates
+   */
+  BatchResult findPointsWithinRadius(const std::vector<Coord>& coords, const std::vector<double>& radii,
+                                     Euclid::ThreadPool& pool) const;
+
+  /// Same as above, with the same radius for all the queries
+  BatchResult findPointsWithinRadius(const std::vector<Coord>& coords, double radius, Euclid::ThreadPool& pool) const;
+
+  /**
+   * Counts the pairs of points, one of this tree and one of the other, by distance
+   * @param other
+   *    The tree with the second point of the pairs (it can be this tree, but then
+   *    every pair of distinct points is counted twice, see the overload below)
+   * @param edges
+   *    The edges of the distance bins, in increasing order
+   * @param pool
+   *    The pool executing the traversal
+   * @return
+   *    The number of pairs in each bin: the element i counts the pairs with
+   *    edges[i] <= distance < edges[i + 1]
+   * @throws Elements::Exception
+   *    If there are less than two edges, the first one is negative or they are
+   *    not increasing
+   */
+  std::vector<size_t> countPairs(const KdTree& other, const std::vector<double>& edges,
+                                 Euclid::ThreadPool& pool) const;
+
+  /// Same as above, counting each unordered pair of distinct points of this tree once
+  std::vector<size_t> countPairs(const std::vector<double>& edges, Euclid::ThreadPool& pool) const;
+
+  /**
+   * Groups the points with the friends-of-friends algorithm: two points closer
+   * than the linking length belong to the same group, and so do their friends
+   * @return
+   *    The group of each point, in the order of the vector the tree was built from.
+   *    The groups are numbered from zero, in the order of their first point.
+   * @throws Elements::Exception
+   *    If the linking length is not positive
+   */
+  std::vector<size_t> findGroups(double linking_length, Euclid::ThreadPool& pool) const;
+
+  /**
+   * Finds the k points closest to the given coordinates
+   * @return
+   *    The neighbours sorted by increasing distance. If the tree has fewer
+   *    than k points, all of them are returned.
+   */
+  std::vector<Neighbor> findNearest(Coord coord, size_t k) const;
+
+  /**
+   * Finds k points approximately closest to the given coordinates
+   * @details
+   * The subtrees which can not contain a point closer than the current k-th
+   * neighbour divided by (1 + epsilon) are skipped, so the distance of the
+   * i-th neighbour returned is at most (1 + epsilon) times the distance of the
+   * true i-th nearest neighbour. Zero gives the exact neighbours.
+   * @return
+   *    The neighbours sorted by increasing distance
+   * @throws Elements::Exception
+   *    If epsilon is negative
+   */
+  std::vector<Neighbor> findNearest(Coord coord, size_t k, double epsilon) const;
+
+  /**
+   * Finds the point closest to the given coordinates
+   * @throws Elements::Exception
+   *    If the tree is empty
+   */
+  Neighbor findNearest(Coord coord) const;
+
+  /// Returns the number of points in the tree
+  size_t size() const;
+
+  /**
+   * Writes the tree to a file, which can be memory mapped by open()
+   * @details
+   * The file starts with a header identifying the format, its version, the
+   * byte order and the template parameters of the tree, followed by the arrays
+   * of the tree exactly as they are in memory, including the points. T must
+   * then be trivially copyable, and the file can only be read back on a machine
+   * with the same byte order and type sizes.
+   * @throws Elements::Exception
+   *    If the file can not be written
+   */
+  void save(const std::string& path) const;
+
+  /**
+   * Opens a tree written by save()
+   * @details
+   * The file is memory mapped and the tree uses its arrays directly, without
+   * copying or parsing them, so the queries can start immediately and the
+   * processes opening the same file share the memory of the page cache.
+   * @param path
+   *    The file to open
+   * @param verify_checksum
+   *    If true, the checksum of the arrays is verified, which requires reading
+   *    the whole file once
+   * @throws Elements::Exception
+   *    If the file is not a tree of the same type, has a different byte order,
+   *    is truncated, or the checksum does not match
+   */
+  static KdTree open(const std::string& path, bool verify_checksum = true);
+
 private:
-  class Node;
-  class Leaf;
-  class Split;
+  /// Reads the points of its static trees when merging them
+  template<typename, size_t, size_t>
+  friend class DynamicKdTree;
+
+  struct Node;
+  struct Arrays;
+  struct Builder;
+  struct PairCounter;
+  struct GroupFinder;
+
+  /// Builds the tree, running the big subtrees as tasks of the given group, if any
+  void build(const std::vector<T>& data, Euclid::TaskGroup* group, size_t parallel_threshold);
+
+  /// Returns the number of nodes of a tree with the given number of points
+  static size_t nodeCount(size_t size);
+
+  /// Returns the bounding box of a node: the N minimum coordinates followed by the N maximum ones
+  const double* bounds(size_t node_index) const;
+
+  /// Returns the minimum squared distance between the points of two bounding boxes
+  static double minSquareDistance(const double* a, const double* b);
+
+  /// Returns the maximum squared distance between the points of two bounding boxes
+  static double maxSquareDistance(const double* a, const double* b);
+
+  /// Returns the minimum squared distance between coord and the points of a bounding box
+  static double minSquareDistance(const Coord& coord, const double* box);
+
+  /// Implements the batch queries, reading the radius of the query i from radii[i * radius_stride]
+  BatchResult findPointsWithinRadius(const std::vector<Coord>& coords, const double* radii, size_t radius_stride,
+                                     Euclid::ThreadPool& pool) const;
+
+  /// Returns the order of the given coordinates along a Morton (Z-order) curve
+  static std::vector<size_t> spatialOrder(const std::vector<Coord>& coords);
+
+  /// Calls visitor with the index (in tree order) of every point closer than radius to coord
+  template<typename Visitor>
+  void visitPointsWithinRadius(const Coord& coord, double radius, Visitor&& visitor) const;
+
+  /// Calls visitor with the index of every point in [begin, end) closer than the square root of square_radius to coord
+  template<typename Visitor>
+  void scanPoints(const double* coord, size_t begin, size_t end, double square_radius, Visitor&& visitor) const;
+
+  /// Returns the number of points in [begin, end) closer than the square root of square_radius to coord
+  size_t countPoints(const double* coord, size_t begin, size_t end, double square_radius) const;
+
+  /// Copies the coordinates of the point at the given index
+  void pointCoord(size_t index, double* coord) const;
+
+  /// Returns the squared distance between coord and the point at the given index
+  double squareDistance(const Coord& coord, size_t index) const;
+
+  /// Searches the subtree under the given node for points closer than the k
+  /// found so far, kept as a max-heap of (squared distance, index) pairs.
+  /// The nodes whose squared distance times square_factor is not smaller than
+  /// the k-th one found are skipped.
+  void searchNearest(size_t node_index, const Coord& coord, size_t k, double square_factor,
+                     std::vector<std::pair<double, size_t>>& heap) const;
+
+  /// Same as searchNearest for k=1, without the heap
+  void searchNearest(size_t node_index, const Coord& coord, double& best_square_dist, size_t& best) const;
+
+  /// A read-only array, kept alive by m_storage
+  template<typename U>
+  class View {
+  public:
+    View() = default;
+    View(const U* data, size_t size) : m_data(data), m_size(size) {}
+    const U& operator[](size_t i) const {
+      return m_data[i];
+    }
+    const U* data() const {
+      return m_data;
+    }
+    size_t size() const {
+      return m_size;
+    }
+    bool empty() const {
+      return m_size == 0;
+    }
+    const U* begin() const {
+      return m_data;
+    }
+    const U* end() const {
+      return m_data + m_size;
+    }
+
+  private:
+    const U* m_data = nullptr;
+    size_t m_size = 0;
+  };
+
+  /// Used by open(), for a tree whose arrays live in storage
+  KdTree(std::shared_ptr<const void> storage, View<Node> nodes, View<T> points, View<size_t> indices,
+         View<double> coords, View<double> bounds);
+
+  /// Computes the bounding boxes of the nodes, from the leaves up
+  static void computeBounds(Arrays& arrays);
 
-  std::shared_ptr<Node> m_root;
+  /// The memory of the arrays below: the vectors of a built tree, or a mapped file.
+  /// Copies of the tree share it, as it is never modified.
+  std::shared_ptr<const void> m_storage;
+  View<Node> m_nodes;
+  View<T> m_points;
+  /// The position of each point in the input vector, in tree order
+  View<size_t> m_indices;
+  /// The coordinates of the points in tree order, all the ones of the first dimension first
+  View<double> m_coords;
+  /// The bounding boxes of the nodes, 2N values per node (see bounds())
+  View<double> m_bounds;
 };
 
 }  // namespace KdTree
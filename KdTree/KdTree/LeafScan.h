@@ -0,0 +1,73 @@
+/** Copyright © 2021 Université de Genève, LMU Munich - Faculty of Physics, IAP-CNRS/Sorbonne Université
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _SEUTILS_LEAFSCAN_H_
+#define _SEUTILS_LEAFSCAN_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace KdTree {
+
+/// Maximum number of points a single call to scanLeaf() can process
+constexpr size_t LEAF_SCAN_BLOCK = 256;
+
+/// The implementations of scanLeaf()
+enum class LeafScanKernel { Scalar, AVX2, AVX512 };
+
+/// Returns true if the CPU the program runs on can execute the given kernel
+bool isSupported(LeafScanKernel kernel);
+
+/// Returns the fastest kernel supported by the CPU, which is the one scanLeaf() uses
+LeafScanKernel defaultLeafScanKernel();
+
+/**
+ * Finds the points of a leaf closer than a radius to some coordinates
+ * @details
+ * The coordinates of the points are given as one array per dimension, so the
+ * squared distances of several points are computed at once with SIMD
+ * instructions, if the CPU supports them. The distances are accumulated over
+ * the dimensions in order, exactly like the scalar code does.
+ * @param axes
+ *    One pointer per dimension, each to the count coordinates of the points along it
+ * @param dimensions
+ *    The number of dimensions
+ * @param count
+ *    The number of points, at most LEAF_SCAN_BLOCK
+ * @param coord
+ *    The coordinates of the center, one per dimension
+ * @param square_radius
+ *    The square of the radius. Only the points with a strictly smaller squared distance match.
+ * @param out
+ *    Receives the positions (from 0 to count - 1) of the matching points, in increasing order
+ * @return
+ *    The number of matching points
+ */
+size_t scanLeaf(const double* const* axes, size_t dimensions, size_t count, const double* coord,
+                double square_radius, uint32_t* out);
+
+/**
+ * Same as above, with the given kernel
+ * @throws Elements::Exception
+ *    If the kernel is not supported by the CPU
+ */
+size_t scanLeaf(LeafScanKernel kernel, const double* const* axes, size_t dimensions, size_t count,
+                const double* coord, double square_radius, uint32_t* out);
+
+}  // namespace KdTree
+
+#endif /* _SEUTILS_LEAFSCAN_H_ */
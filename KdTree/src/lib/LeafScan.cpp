@@ -0,0 +1,160 @@
+/** Copyright © 2021 Université de Genève, LMU Munich - Faculty of Physics, IAP-CNRS/Sorbonne Université
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "KdTree/LeafScan.h"
+#include "ElementsKernel/Exception.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KDTREE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace KdTree {
+
+namespace {
+
+/// Scans the points [first, count) one at a time
+size_t scanScalar(const double* const* axes, size_t dimensions, size_t first, size_t count, const double* coord,
+                  double square_radius, uint32_t* out) {
+  size_t found = 0;
+  for (size_t i = first; i < count; ++i) {
+    double square_dist = 0.0;
+    for (size_t j = 0; j < dimensions; ++j) {
+      double delta = axes[j][i] - coord[j];
+      square_dist += delta * delta;
+    }
+    if (square_dist < square_radius) {
+      out[found++] = static_cast<uint32_t>(i);
+    }
+  }
+  return found;
+}
+
+/// Appends the positions of the bits set in mask, offset by first
+inline size_t emitMask(unsigned mask, size_t first, uint32_t* out) {
+  size_t found = 0;
+  while (mask) {
+    out[found++] = static_cast<uint32_t>(first + __builtin_ctz(mask));
+    mask &= mask - 1;
+  }
+  return found;
+}
+
+#ifdef KDTREE_X86_KERNELS
+
+// The kernels must not fuse the multiplications and the additions, so the distances
+// are rounded like the scalar ones. The AVX2 one is compiled without FMA support and
+// the AVX-512 one uses the explicit rounding intrinsics, which are never contracted.
+
+__attribute__((target("avx2"))) size_t scanAVX2(const double* const* axes, size_t dimensions, size_t count,
+                                                const double* coord, double square_radius, uint32_t* out) {
+  const __m256d radius = _mm256_set1_pd(square_radius);
+  size_t        found  = 0;
+  size_t        i      = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256d square_dist = _mm256_setzero_pd();
+    for (size_t j = 0; j < dimensions; ++j) {
+      __m256d delta = _mm256_sub_pd(_mm256_loadu_pd(axes[j] + i), _mm256_set1_pd(coord[j]));
+      square_dist   = _mm256_add_pd(square_dist, _mm256_mul_pd(delta, delta));
+    }
+    unsigned mask = _mm256_movemask_pd(_mm256_cmp_pd(square_dist, radius, _CMP_LT_OQ));
+    found += emitMask(mask, i, out + found);
+  }
+  return found + scanScalar(axes, dimensions, i, count, coord, square_radius, out + found);
+}
+
+__attribute__((target("avx512f"))) size_t scanAVX512(const double* const* axes, size_t dimensions, size_t count,
+                                                     const double* coord, double square_radius, uint32_t* out) {
+  const __m512d radius = _mm512_set1_pd(square_radius);
+  size_t        found  = 0;
+  for (size_t i = 0; i < count; i += 8) {
+    // The last iteration loads only the remaining points
+    __mmask8 lanes       = (count - i >= 8) ? 0xFF : static_cast<__mmask8>((1u << (count - i)) - 1);
+    __m512d  square_dist = _mm512_setzero_pd();
+    for (size_t j = 0; j < dimensions; ++j) {
+      __m512d delta  = _mm512_sub_pd(_mm512_maskz_loadu_pd(lanes, axes[j] + i), _mm512_set1_pd(coord[j]));
+      __m512d square = _mm512_mask_mul_round_pd(delta, 0xFF, delta, delta, _MM_FROUND_CUR_DIRECTION);
+      square_dist    = _mm512_mask_add_round_pd(square_dist, 0xFF, square_dist, square, _MM_FROUND_CUR_DIRECTION);
+    }
+    __mmask8 mask = _mm512_mask_cmp_pd_mask(lanes, square_dist, radius, _CMP_LT_OQ);
+    found += emitMask(mask, i, out + found);
+  }
+  return found;
+}
+
+#endif
+
+using Kernel = size_t (*)(const double* const*, size_t, size_t, const double*, double, uint32_t*);
+
+size_t scanScalarKernel(const double* const* axes, size_t dimensions, size_t count, const double* coord,
+                        double square_radius, uint32_t* out) {
+  return scanScalar(axes, dimensions, 0, count, coord, square_radius, out);
+}
+
+Kernel kernelFunction(LeafScanKernel kernel) {
+  switch (kernel) {
+#ifdef KDTREE_X86_KERNELS
+  case LeafScanKernel::AVX2:
+    return scanAVX2;
+  case LeafScanKernel::AVX512:
+    return scanAVX512;
+#endif
+  default:
+    return scanScalarKernel;
+  }
+}
+
+}  // namespace
+
+bool isSupported(LeafScanKernel kernel) {
+  switch (kernel) {
+  case LeafScanKernel::Scalar:
+    return true;
+#ifdef KDTREE_X86_KERNELS
+  case LeafScanKernel::AVX2:
+    return __builtin_cpu_supports("avx2");
+  case LeafScanKernel::AVX512:
+    return __builtin_cpu_supports("avx512f");
+#endif
+  default:
+    return false;
+  }
+}
+
+LeafScanKernel defaultLeafScanKernel() {
+  static const LeafScanKernel kernel = isSupported(LeafScanKernel::AVX512) ? LeafScanKernel::AVX512
+                                       : isSupported(LeafScanKernel::AVX2) ? LeafScanKernel::AVX2
+                                                                           : LeafScanKernel::Scalar;
+  return kernel;
+}
+
+size_t scanLeaf(const double* const* axes, size_t dimensions, size_t count, const double* coord,
+                double square_radius, uint32_t* out) {
+  static const Kernel kernel = kernelFunction(defaultLeafScanKernel());
+  return kernel(axes, dimensions, count, coord, square_radius, out);
+}
+
+size_t scanLeaf(LeafScanKernel kernel, const double* const* axes, size_t dimensions, size_t count,
+                const double* coord, double square_radius, uint32_t* out) {
+  if (!isSupported(kernel)) {
+    throw Elements::Exception() << "The leaf scan kernel " << static_cast<int>(kernel)
+                                << " is not supported by this CPU";
+  }
+  return kernelFunction(kernel)(axes, dimensions, count, coord, square_radius, out);
+}
+
+}  // namespace KdTree
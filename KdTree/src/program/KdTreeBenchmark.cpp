@@ -0,0 +1,417 @@
+/** Copyright © 2021 Université de Genève, LMU Munich - Faculty of Physics, IAP-CNRS/Sorbonne Université
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file src/program/KdTreeBenchmark.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AlexandriaKernel/AllocationCounter.h"
+#include "AlexandriaKernel/ThreadPool.h"
+#include "ElementsKernel/ProgramHeaders.h"
+#include "ElementsKernel/Temporary.h"
+#include "KdTree/DynamicKdTree.h"
+#include "KdTree/KdTree.h"
+#include <boost/program_options.hpp>
+
+using boost::program_options::options_description;
+using boost::program_options::value;
+using boost::program_options::variable_value;
+
+namespace {
+
+struct Point {
+  std::array<double, 3> coords;
+  size_t                id;
+};
+
+}  // namespace
+
+namespace KdTree {
+template <>
+struct KdTreeTraits<Point> {
+  static double getCoord(const Point& p, size_t index) {
+    return p.coords[index];
+  }
+};
+}  // namespace KdTree
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double toSeconds(Clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+/**
+ * The pointer based tree the KdTree used to be, kept as a reference for the
+ * benchmark: every node is a separate heap object and every leaf owns its points.
+ */
+template <typename T, size_t N, size_t S>
+class PointerKdTree {
+public:
+  using Traits = KdTree::KdTreeTraits<T>;
+  using Coord  = typename KdTree::KdTree<T, N, S>::Coord;
+
+  explicit PointerKdTree(const std::vector<T>& data) {
+    if (data.size() > S) {
+      m_root = std::make_shared<Split>(data, 0);
+    } else {
+      m_root = std::make_shared<Leaf>(std::vector<T>(data));
+    }
+  }
+
+  std::vector<T> findPointsWithinRadius(Coord coord, double radius) const {
+    return m_root->findPointsWithinRadius(coord, radius);
+  }
+
+private:
+  class Node {
+  public:
+    virtual std::vector<T> findPointsWithinRadius(Coord coord, double radius) const = 0;
+    virtual ~Node()                                                               = default;
+  };
+
+  class Leaf : public Node {
+  public:
+    explicit Leaf(std::vector<T>&& data) : m_data(std::move(data)) {}
+
+    std::vector<T> findPointsWithinRadius(Coord coord, double radius) const override {
+      std::vector<T> selection;
+      for (auto& entry : m_data) {
+        double square_dist = 0.0;
+        for (size_t i = 0; i < N; i++) {
+          double delta = Traits::getCoord(entry, i) - coord.coord[i];
+          square_dist += delta * delta;
+        }
+        if (square_dist < radius * radius) {
+          selection.push_back(entry);
+        }
+      }
+      return selection;
+    }
+
+  private:
+    const std::vector<T> m_data;
+  };
+
+  class Split : public Node {
+  public:
+    Split(std::vector<T> data, size_t axis) : m_axis(axis) {
+      std::sort(data.begin(), data.end(), [axis](const T& a, const T& b) -> bool {
+        return Traits::getCoord(a, axis) < Traits::getCoord(b, axis);
+      });
+      double a      = Traits::getCoord(data.at(data.size() / 2 - 1), axis);
+      double b      = Traits::getCoord(data.at(data.size() / 2), axis);
+      m_split_value = (a == b) ? a : (a + b) / 2.0;
+
+      std::vector<T> left(data.begin(), data.begin() + data.size() / 2);
+      std::vector<T> right(data.begin() + data.size() / 2, data.end());
+      m_left_child  = makeChild(std::move(left), (axis + 1) % N);
+      m_right_child = makeChild(std::move(right), (axis + 1) % N);
+    }
+
+    std::vector<T> findPointsWithinRadius(Coord coord, double radius) const override {
+      if (coord.coord[m_axis] + radius < m_split_value) {
+        return m_left_child->findPointsWithinRadius(coord, radius);
+      } else if (coord.coord[m_axis] - radius > m_split_value) {
+        return m_right_child->findPointsWithinRadius(coord, radius);
+      }
+      auto           left  = m_left_child->findPointsWithinRadius(coord, radius);
+      auto           right = m_right_child->findPointsWithinRadius(coord, radius);
+      std::vector<T> merge;
+      merge.reserve(left.size() + right.size());
+      merge.insert(merge.end(), left.begin(), left.end());
+      merge.insert(merge.end(), right.begin(), right.end());
+      return merge;
+    }
+
+  private:
+    static std::shared_ptr<Node> makeChild(std::vector<T>&& data, size_t axis) {
+      if (data.size() > S) {
+        return std::make_shared<Split>(std::move(data), axis);
+      }
+      return std::make_shared<Leaf>(std::move(data));
+    }
+
+    size_t                m_axis;
+    double                m_split_value;
+    std::shared_ptr<Node> m_left_child;
+    std::shared_ptr<Node> m_right_child;
+  };
+
+  std::shared_ptr<Node> m_root;
+};
+
+/// Builds a tree and runs all the queries, returning the total number of matches
+template <typename Tree>
+size_t run(const std::string& name, const std::vector<Point>& points, const std::vector<Point>& queries,
+           double radius, std::unique_ptr<Tree>& tree) {
+  auto start = Clock::now();
+  tree.reset(new Tree{points});
+  auto built = Clock::now();
+
+  size_t matches = 0;
+  for (auto& q : queries) {
+    matches += tree->findPointsWithinRadius({q.coords[0], q.coords[1], q.coords[2]}, radius).size();
+  }
+  auto queried = Clock::now();
+
+  std::cout << std::setw(10) << name << std::fixed << std::setprecision(3) << std::setw(14) << toSeconds(built - start)
+            << std::setw(14) << toSeconds(queried - built) << std::setw(14) << std::setprecision(2)
+            << 1e6 * toSeconds(queried - built) / queries.size() << std::setw(14) << matches << std::endl;
+  return matches;
+}
+
+/// Runs all the queries with one of the radius query flavours, reporting the time and the
+/// heap allocations per query
+template <typename Query>
+void runVariant(const std::string& name, const std::vector<Point>& queries, size_t expected_matches, Query query) {
+  size_t matches     = 0;
+  auto   allocations = Euclid::allocationCount();
+  auto   start       = Clock::now();
+  for (auto& q : queries) {
+    matches += query(q);
+  }
+  auto elapsed = Clock::now() - start;
+  allocations  = Euclid::allocationCount() - allocations;
+  if (matches != expected_matches) {
+    throw std::runtime_error("The " + name + " query found a different number of matches");
+  }
+  std::cout << std::setw(16) << name << std::fixed << std::setprecision(2) << std::setw(14)
+            << 1e6 * toSeconds(elapsed) / queries.size() << std::setw(18) << std::setprecision(3)
+            << static_cast<double>(allocations) / queries.size() << std::endl;
+}
+
+}  // namespace
+
+class KdTreeBenchmark : public Elements::Program {
+
+public:
+  options_description defineSpecificProgramOptions() override {
+    options_description options{};
+    options.add_options()("points", value<size_t>()->default_value(10000000), "Number of points in the tree")(
+        "queries", value<size_t>()->default_value(100000), "Number of radius queries")(
+        "radius", value<double>()->default_value(0.01), "Radius of the queries (the points are in a unit cube)")(
+        "seed", value<unsigned int>()->default_value(42), "Seed of the random generator")(
+        "threads", value<unsigned int>()->default_value(std::thread::hardware_concurrency()),
+        "Number of threads for the parallel build");
+    return options;
+  }
+
+  Elements::ExitCode mainMethod(std::map<std::string, variable_value>& args) override {
+    auto npoints  = args.at("points").as<size_t>();
+    auto nqueries = args.at("queries").as<size_t>();
+    auto radius   = args.at("radius").as<double>();
+    if (nqueries == 0) {
+      throw std::invalid_argument("At least one query is required");
+    }
+
+    std::mt19937                     generator{args.at("seed").as<unsigned int>()};
+    std::uniform_real_distribution<> uniform{0., 1.};
+    auto                             random_points = [&generator, &uniform](size_t n) {
+      std::vector<Point> points(n);
+      for (size_t i = 0; i < n; ++i) {
+        points[i] = Point{{uniform(generator), uniform(generator), uniform(generator)}, i};
+      }
+      return points;
+    };
+    auto points  = random_points(npoints);
+    auto queries = random_points(nqueries);
+
+    std::cout << "Points: " << npoints << ", queries: " << nqueries << ", radius: " << radius << std::endl;
+    std::cout << std::setw(10) << "Layout" << std::setw(14) << "Build s" << std::setw(14) << "Queries s"
+              << std::setw(14) << "us/query" << std::setw(14) << "Matches" << std::endl;
+
+    std::unique_ptr<PointerKdTree<Point, 3, 100>>  pointer_tree;
+    std::unique_ptr<KdTree::KdTree<Point, 3, 100>> tree;
+    auto pointer_matches = run("pointer", points, queries, radius, pointer_tree);
+    pointer_tree.reset();
+    auto matches = run("flat", points, queries, radius, tree);
+    if (pointer_matches != matches) {
+      throw std::runtime_error("The two trees found different number of matches");
+    }
+
+    auto               threads = args.at("threads").as<unsigned int>();
+    Euclid::ThreadPool pool{threads};
+    auto               start = Clock::now();
+    tree.reset(new KdTree::KdTree<Point, 3, 100>{points, pool});
+    std::cout << std::endl
+              << "Parallel build with " << threads << " threads: " << std::setprecision(3)
+              << toSeconds(Clock::now() - start) << " s" << std::endl;
+
+    std::cout << std::endl
+              << std::setw(16) << "Query" << std::setw(14) << "us/query" << std::setw(18) << "Allocs/query"
+              << std::endl;
+    runVariant("vector", queries, matches, [&tree, radius](const Point& q) {
+      return tree->findPointsWithinRadius({q.coords[0], q.coords[1], q.coords[2]}, radius).size();
+    });
+    std::vector<Point> buffer;
+    runVariant("buffer", queries, matches, [&tree, &buffer, radius](const Point& q) {
+      tree->findPointsWithinRadius({q.coords[0], q.coords[1], q.coords[2]}, radius, buffer);
+      return buffer.size();
+    });
+    std::vector<Point> output;
+    runVariant("output iterator", queries, matches, [&tree, &output, radius](const Point& q) {
+      output.clear();
+      tree->findPointsWithinRadius({q.coords[0], q.coords[1], q.coords[2]}, radius, std::back_inserter(output));
+      return output.size();
+    });
+    runVariant("visitor", queries, matches, [&tree, radius](const Point& q) {
+      size_t found = 0;
+      tree->forEachPointWithinRadius({q.coords[0], q.coords[1], q.coords[2]}, radius,
+                                     [&found](const Point&) { ++found; });
+      return found;
+    });
+    runVariant("count", queries, matches, [&tree, radius](const Point& q) {
+      return tree->countPointsWithinRadius({q.coords[0], q.coords[1], q.coords[2]}, radius);
+    });
+
+    std::vector<KdTree::KdTree<Point, 3, 100>::Coord> coords;
+    coords.reserve(queries.size());
+    for (auto& q : queries) {
+      coords.push_back({q.coords[0], q.coords[1], q.coords[2]});
+    }
+    start        = Clock::now();
+    auto result  = tree->findPointsWithinRadius(coords, radius, pool);
+    auto elapsed = Clock::now() - start;
+    if (result.indices.size() != matches) {
+      throw std::runtime_error("The batch query found a different number of matches");
+    }
+    std::cout << std::setw(16) << "batch" << std::setprecision(2) << std::setw(14)
+              << 1e6 * toSeconds(elapsed) / queries.size() << std::endl;
+
+    // Pairs closer than the radius among the query points, counted point by point and with the dual-tree traversal
+    KdTree::KdTree<Point, 3, 100> query_tree{queries, pool};
+    start             = Clock::now();
+    size_t self_pairs = 0;
+    for (auto& q : queries) {
+      self_pairs += query_tree.countPointsWithinRadius({q.coords[0], q.coords[1], q.coords[2]}, radius * 10) - 1;
+    }
+    self_pairs /= 2;
+    auto per_point = Clock::now() - start;
+    start          = Clock::now();
+    auto counts    = query_tree.countPairs({0., radius * 10}, pool);
+    auto dual_tree = Clock::now() - start;
+    if (counts[0] != self_pairs) {
+      throw std::runtime_error("The dual-tree traversal found a different number of pairs");
+    }
+    start       = Clock::now();
+    auto groups = query_tree.findGroups(radius * 2, pool);
+    auto fof    = Clock::now() - start;
+    std::cout << std::endl
+              << "Pairs of queries closer than " << radius * 10 << ": " << self_pairs << std::endl
+              << "  per point " << std::setprecision(3) << toSeconds(per_point) << " s, dual-tree "
+              << toSeconds(dual_tree) << " s" << std::endl
+              << "Friends-of-friends groups with linking length " << radius * 2 << ": "
+              << *std::max_element(groups.begin(), groups.end()) + 1 << " in "
+              << toSeconds(fof) << " s" << std::endl;
+
+    // Persisting the tree, and mapping it back instead of building it again
+    Elements::TempFile file("kdtree_benchmark_%%%%.bin");
+    start = Clock::now();
+    tree->save(file.path().native());
+    auto saved = Clock::now() - start;
+    tree.reset();
+    start           = Clock::now();
+    auto unverified = KdTree::KdTree<Point, 3, 100>::open(file.path().native(), false);
+    auto mapped     = Clock::now() - start;
+    start           = Clock::now();
+    auto verified   = KdTree::KdTree<Point, 3, 100>::open(file.path().native());
+    auto checked    = Clock::now() - start;
+    size_t mapped_matches = 0;
+    for (auto& q : queries) {
+      mapped_matches += verified.countPointsWithinRadius({q.coords[0], q.coords[1], q.coords[2]}, radius);
+    }
+    if (mapped_matches != matches || unverified.size() != points.size()) {
+      throw std::runtime_error("The mapped tree found a different number of matches");
+    }
+    std::cout << std::endl
+              << "Save " << std::setprecision(3) << toSeconds(saved) << " s, open " << toSeconds(mapped)
+              << " s, open with checksum " << toSeconds(checked) << " s" << std::endl;
+
+    // Boxes circumscribing the radius queries, and nearest neighbours, exact and approximate
+    start              = Clock::now();
+    size_t box_matches = 0;
+    for (auto& q : queries) {
+      box_matches += verified
+                         .findPointsInBox({q.coords[0] - radius, q.coords[1] - radius, q.coords[2] - radius},
+                                          {q.coords[0] + radius, q.coords[1] + radius, q.coords[2] + radius})
+                         .size();
+    }
+    auto boxes = Clock::now() - start;
+    std::cout << std::endl
+              << "Box queries: " << std::setprecision(2) << 1e6 * toSeconds(boxes) / queries.size()
+              << " us/query, " << box_matches << " matches" << std::endl;
+    for (double epsilon : {0., 0.5, 2.}) {
+      start           = Clock::now();
+      double distance = 0;
+      for (auto& q : queries) {
+        auto neighbors = verified.findNearest({q.coords[0], q.coords[1], q.coords[2]}, 10, epsilon);
+        distance += neighbors.empty() ? 0. : neighbors.back().distance;
+      }
+      auto elapsed = Clock::now() - start;
+      std::cout << "10 nearest neighbours, epsilon " << std::setprecision(1) << epsilon << ": " << std::setprecision(2)
+                << 1e6 * toSeconds(elapsed) / queries.size() << " us/query, mean 10th distance "
+                << std::setprecision(4) << distance / queries.size() << std::endl;
+    }
+
+    // A stream of points, keeping only the last nqueries in the dynamic tree
+    KdTree::DynamicKdTree<Point, 3, 100> dynamic{pool};
+    std::vector<size_t>                  ids;
+    size_t                               stream_size = std::min(points.size(), 2 * queries.size());
+    start                                            = Clock::now();
+    for (size_t i = 0; i < stream_size; ++i) {
+      ids.push_back(dynamic.insert(points[i]));
+      if (i >= queries.size()) {
+        dynamic.erase(ids[i - queries.size()]);
+      }
+    }
+    auto streamed = Clock::now() - start;
+    start         = Clock::now();
+    size_t dynamic_matches = 0;
+    for (auto& q : queries) {
+      dynamic_matches += dynamic.countPointsWithinRadius({q.coords[0], q.coords[1], q.coords[2]}, radius * 10);
+    }
+    auto dynamic_queries = Clock::now() - start;
+    std::cout << std::endl
+              << "Dynamic tree: " << stream_size << " insertions and " << stream_size - dynamic.size()
+              << " deletions in " << std::setprecision(3) << toSeconds(streamed) << " s, " << std::setprecision(2)
+              << 1e6 * toSeconds(dynamic_queries) / queries.size() << " us/query with radius " << radius * 10
+              << " (" << dynamic_matches << " matches)" << std::endl;
+    return Elements::ExitCode::OK;
+  }
+};
+
+MAIN_FOR(KdTreeBenchmark)
@@ -0,0 +1,223 @@
+/**
+ * @copyright (C) 2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#include "KdTree/DynamicKdTree.h"
+#include "AlexandriaKernel/ThreadPool.h"
+#include <boost/test/unit_test.hpp>
+#include <array>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+struct Source {
+  std::array<double, 3> m_coords;
+  int                   m_label;
+};
+
+}  // namespace
+
+namespace KdTree {
+template <>
+struct KdTreeTraits<Source> {
+  static double getCoord(const Source& s, size_t index) {
+    return s.m_coords[index];
+  }
+};
+}  // namespace KdTree
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+/// Keeps the points inserted in a DynamicKdTree, to compare its queries with brute force
+struct StreamFixture {
+  std::map<size_t, Source>         live;
+  std::mt19937                     generator{42};
+  std::uniform_real_distribution<> uniform{0., 10.};
+
+  Source randomSource(int label) {
+    return Source{{uniform(generator), uniform(generator), uniform(generator)}, label};
+  }
+
+  static double distance(const Source& s, const std::array<double, 3>& coord) {
+    double square_dist = 0;
+    for (size_t i = 0; i < 3; ++i) {
+      square_dist += (s.m_coords[i] - coord[i]) * (s.m_coords[i] - coord[i]);
+    }
+    return std::sqrt(square_dist);
+  }
+
+  static std::vector<int> sortedLabels(const std::vector<Source>& sources) {
+    std::vector<int> labels;
+    for (auto& s : sources) {
+      labels.push_back(s.m_label);
+    }
+    std::sort(labels.begin(), labels.end());
+    return labels;
+  }
+
+  template <typename Tree>
+  void checkQueries(const Tree& tree) {
+    BOOST_REQUIRE_EQUAL(tree.size(), live.size());
+    for (int q = 0; q < 20; ++q) {
+      std::array<double, 3> coord{uniform(generator), uniform(generator), uniform(generator)};
+
+      std::vector<int>    expected;
+      std::vector<double> distances;
+      for (auto& entry : live) {
+        double d = distance(entry.second, coord);
+        if (d < 1.5) {
+          expected.push_back(entry.second.m_label);
+        }
+        distances.push_back(d);
+      }
+      std::sort(expected.begin(), expected.end());
+      std::sort(distances.begin(), distances.end());
+
+      auto found = sortedLabels(tree.findPointsWithinRadius({coord[0], coord[1], coord[2]}, 1.5));
+      BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+      BOOST_CHECK_EQUAL(tree.countPointsWithinRadius({coord[0], coord[1], coord[2]}, 1.5), expected.size());
+
+      auto neighbors = tree.findNearest({coord[0], coord[1], coord[2]}, 7);
+      BOOST_REQUIRE_EQUAL(neighbors.size(), std::min<size_t>(7, live.size()));
+      for (size_t i = 0; i < neighbors.size(); ++i) {
+        BOOST_CHECK_CLOSE(neighbors[i].distance, distances[i], 1e-8);
+      }
+
+      std::vector<int> in_box;
+      for (auto& entry : live) {
+        auto& c = entry.second.m_coords;
+        if (c[0] >= coord[0] - 1 && c[0] <= coord[0] + 2 && c[1] >= coord[1] - 2 && c[1] <= coord[1] + 1 &&
+            c[2] >= coord[2] - 1 && c[2] <= coord[2] + 1) {
+          in_box.push_back(entry.second.m_label);
+        }
+      }
+      std::sort(in_box.begin(), in_box.end());
+      found = sortedLabels(tree.findPointsInBox({coord[0] - 1, coord[1] - 2, coord[2] - 1},
+                                                {coord[0] + 2, coord[1] + 1, coord[2] + 1}));
+      BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), in_box.begin(), in_box.end());
+    }
+  }
+};
+
+}  // namespace
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(DynamicKdTree_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(Empty_test) {
+  KdTree::DynamicKdTree<Source, 3, 8> tree;
+  BOOST_CHECK_EQUAL(tree.size(), 0);
+  BOOST_CHECK(tree.findPointsWithinRadius({1., 1., 1.}, 10.).empty());
+  BOOST_CHECK(tree.findNearest({1., 1., 1.}, 3).empty());
+  BOOST_CHECK(!tree.erase(0));
+  BOOST_CHECK(!tree.contains(0));
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(InsertErase_test, StreamFixture) {
+  KdTree::DynamicKdTree<Source, 3, 8> tree;
+
+  // Grow, then keep a sliding window of the most recent points, then shrink
+  std::vector<size_t> ids;
+  int                 label = 0;
+  for (int step = 0; step < 3000; ++step) {
+    if (step < 1000 || (step < 2000 && step % 2 == 0)) {
+      auto source = randomSource(label++);
+      auto id     = tree.insert(source);
+      BOOST_CHECK(live.emplace(id, source).second);
+      ids.push_back(id);
+    } else if (!live.empty()) {
+      auto victim = live.begin();
+      if (step % 3 == 0) {
+        // Not always the oldest one
+        std::advance(victim, generator() % live.size());
+      }
+      BOOST_CHECK(tree.erase(victim->first));
+      BOOST_CHECK(!tree.contains(victim->first));
+      BOOST_CHECK(!tree.erase(victim->first));
+      live.erase(victim);
+    }
+    if (step % 250 == 0) {
+      checkQueries(tree);
+    }
+  }
+  BOOST_CHECK_EQUAL(tree.size(), 0);
+  for (auto id : ids) {
+    BOOST_CHECK(!tree.contains(id));
+  }
+
+  // The tree is still usable, and the identifiers are not reused
+  auto id = tree.insert(randomSource(label));
+  BOOST_CHECK_GT(id, ids.back());
+  BOOST_CHECK(tree.contains(id));
+  BOOST_CHECK_EQUAL(tree.findNearest({1., 1., 1.}, 3).size(), 1);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(LongLivedPoint_test, StreamFixture) {
+  KdTree::DynamicKdTree<Source, 3, 8> tree;
+
+  // A point which is never erased, while many others come and go
+  auto first    = randomSource(0);
+  auto first_id = tree.insert(first);
+  live.emplace(first_id, first);
+  std::vector<size_t> erased;
+  for (int label = 1; label < 5000; ++label) {
+    auto id = tree.insert(randomSource(label));
+    BOOST_CHECK(tree.erase(id));
+    erased.push_back(id);
+  }
+
+  BOOST_CHECK_EQUAL(tree.size(), 1);
+  BOOST_CHECK(tree.contains(first_id));
+  for (auto id : erased) {
+    BOOST_CHECK(!tree.contains(id));
+    BOOST_CHECK(!tree.erase(id));
+  }
+  checkQueries(tree);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(ParallelMerge_test, StreamFixture) {
+  Euclid::ThreadPool                  pool{2};
+  KdTree::DynamicKdTree<Source, 3, 4> tree{pool};
+  for (int i = 0; i < 2000; ++i) {
+    auto source = randomSource(i);
+    live.emplace(tree.insert(source), source);
+  }
+  checkQueries(tree);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//-----------------------------------------------------------------------------
@@ -18,7 +18,15 @@
  */
 
 #include "KdTree/KdTree.h"
+#include "AlexandriaKernel/ThreadPool.h"
+#include <ElementsKernel/Temporary.h>
 #include <boost/test/unit_test.hpp>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
 
 //-----------------------------------------------------------------------------
 
@@ -41,6 +49,25 @@ struct KdTreeTraits<DataNode> {
 
 //-----------------------------------------------------------------------------
 
+/// A trivially copyable point, so the trees can be saved
+struct IndexedPoint {
+  double m_coords[3];
+  size_t m_index;
+};
+
+//-----------------------------------------------------------------------------
+
+namespace KdTree {
+template <>
+struct KdTreeTraits<IndexedPoint> {
+  static double getCoord(const IndexedPoint& t, size_t index) {
+    return t.m_coords[index];
+  }
+};
+}  // namespace KdTree
+
+//-----------------------------------------------------------------------------
+
 struct KdTreeFixture {
   std::vector<DataNode> nodes;
 
@@ -70,6 +97,69 @@ struct KdTreeFixture {
 
 //-----------------------------------------------------------------------------
 
+struct RandomFixture {
+  std::vector<DataNode> nodes;
+
+  // Random points in a 10x10x10 cube, including some duplicated coordinates
+  RandomFixture() : nodes{2000} {
+    std::mt19937                     generator{42};
+    std::uniform_real_distribution<> uniform{0., 10.};
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      if (i % 10 == 9) {
+        nodes[i].m_coords = nodes[i - 1].m_coords;
+      } else {
+        nodes[i].m_coords = {uniform(generator), uniform(generator), uniform(generator)};
+      }
+      nodes[i].m_label = std::to_string(i);
+    }
+  }
+
+  std::vector<std::string> bruteForce(const std::array<double, 3>& coord, double radius) const {
+    std::vector<std::string> labels;
+    for (auto& n : nodes) {
+      double square_dist = 0;
+      for (size_t i = 0; i < 3; ++i) {
+        square_dist += (n.m_coords[i] - coord[i]) * (n.m_coords[i] - coord[i]);
+      }
+      if (square_dist < radius * radius) {
+        labels.push_back(n.m_label);
+      }
+    }
+    std::sort(labels.begin(), labels.end());
+    return labels;
+  }
+
+  std::vector<double> sortedDistances(const std::array<double, 3>& coord) const {
+    std::vector<double> distances;
+    for (auto& n : nodes) {
+      double square_dist = 0;
+      for (size_t i = 0; i < 3; ++i) {
+        square_dist += (n.m_coords[i] - coord[i]) * (n.m_coords[i] - coord[i]);
+      }
+      distances.push_back(std::sqrt(square_dist));
+    }
+    std::sort(distances.begin(), distances.end());
+    return distances;
+  }
+
+  template <typename Neighbors>
+  static void checkDistances(const Neighbors& neighbors, const std::vector<double>& expected, size_t k) {
+    BOOST_REQUIRE_EQUAL(neighbors.size(), k);
+    for (size_t i = 0; i < k; ++i) {
+      BOOST_CHECK_CLOSE(neighbors[i].distance, expected[i], 1e-8);
+    }
+  }
+
+  static std::vector<std::string> sortedLabels(const std::vector<DataNode>& found) {
+    std::vector<std::string> labels;
+    for (auto& n : found) {
+      labels.push_back(n.m_label);
+    }
+    std::sort(labels.begin(), labels.end());
+    return labels;
+  }
+};
+
 //-----------------------------------------------------------------------------
 
 BOOST_AUTO_TEST_SUITE(KdTree_test)
@@ -132,6 +222,457 @@ BOOST_AUTO_TEST_CASE(KdTreeEmpty_test) {
 
 //-----------------------------------------------------------------------------
 
+BOOST_FIXTURE_TEST_CASE(KdTreeRandom_test, RandomFixture) {
+  KdTree::KdTree<DataNode, 3, 4> small_leaves(nodes);
+  KdTree::KdTree<DataNode, 3>    big_leaves(nodes);
+  BOOST_CHECK_EQUAL(small_leaves.size(), nodes.size());
+
+  std::mt19937                     generator{7};
+  std::uniform_real_distribution<> uniform{-1., 11.};
+  for (int q = 0; q < 100; ++q) {
+    std::array<double, 3> coord{uniform(generator), uniform(generator), uniform(generator)};
+    double                radius   = 0.1 * (q % 20);
+    auto                  expected = bruteForce(coord, radius);
+
+    auto found = sortedLabels(small_leaves.findPointsWithinRadius({coord[0], coord[1], coord[2]}, radius));
+    BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+    found = sortedLabels(big_leaves.findPointsWithinRadius({coord[0], coord[1], coord[2]}, radius));
+    BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreeParallelBuild_test, RandomFixture) {
+  KdTree::KdTree<DataNode, 3, 4> serial(nodes);
+
+  Euclid::ThreadPool             pool{4};
+  KdTree::KdTree<DataNode, 3, 4> parallel(nodes, pool, 64);
+  BOOST_CHECK_EQUAL(parallel.size(), nodes.size());
+
+  // The trees must be identical, so the points are found in the same order
+  std::mt19937                     generator{11};
+  std::uniform_real_distribution<> uniform{0., 10.};
+  for (int q = 0; q < 100; ++q) {
+    std::array<double, 3> coord{uniform(generator), uniform(generator), uniform(generator)};
+    double                radius   = uniform(generator) / 4;
+    auto                  expected = serial.findPointsWithinRadius({coord[0], coord[1], coord[2]}, radius);
+    auto                  found    = parallel.findPointsWithinRadius({coord[0], coord[1], coord[2]}, radius);
+    BOOST_REQUIRE_EQUAL(found.size(), expected.size());
+    for (size_t i = 0; i < found.size(); ++i) {
+      BOOST_CHECK_EQUAL(found[i].m_label, expected[i].m_label);
+    }
+    auto labels = sortedLabels(found);
+    auto brute  = bruteForce(coord, radius);
+    BOOST_CHECK_EQUAL_COLLECTIONS(labels.begin(), labels.end(), brute.begin(), brute.end());
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreeBatch_test, RandomFixture) {
+  using Tree = KdTree::KdTree<DataNode, 3, 4>;
+  Tree               tree(nodes);
+  Euclid::ThreadPool pool{4};
+
+  std::mt19937                     generator{5};
+  std::uniform_real_distribution<> uniform{0., 10.};
+  std::vector<Tree::Coord>         coords;
+  std::vector<double>              radii;
+  for (int q = 0; q < 1000; ++q) {
+    coords.push_back({uniform(generator), uniform(generator), uniform(generator)});
+    radii.push_back(uniform(generator) / 10);
+  }
+
+  auto result = tree.findPointsWithinRadius(coords, radii, pool);
+  BOOST_REQUIRE_EQUAL(result.offsets.size(), coords.size() + 1);
+  BOOST_CHECK_EQUAL(result.offsets.back(), result.indices.size());
+  for (size_t q = 0; q < coords.size(); ++q) {
+    std::vector<std::string> found;
+    for (size_t i = result.offsets[q]; i < result.offsets[q + 1]; ++i) {
+      found.push_back(nodes.at(result.indices[i]).m_label);
+    }
+    std::sort(found.begin(), found.end());
+    auto& c        = coords[q].coord;
+    auto  expected = bruteForce({c[0], c[1], c[2]}, radii[q]);
+    BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+  }
+
+  // A single radius for all the queries
+  auto same_radius = tree.findPointsWithinRadius(coords, 0.5, pool);
+  BOOST_REQUIRE_EQUAL(same_radius.offsets.size(), coords.size() + 1);
+  for (size_t q = 0; q < coords.size(); ++q) {
+    BOOST_CHECK_EQUAL(same_radius.offsets[q + 1] - same_radius.offsets[q],
+                      tree.countPointsWithinRadius(coords[q], 0.5));
+  }
+
+  auto empty = tree.findPointsWithinRadius(std::vector<Tree::Coord>{}, 0.5, pool);
+  BOOST_CHECK_EQUAL(empty.offsets.size(), 1);
+  BOOST_CHECK(empty.indices.empty());
+
+  radii.pop_back();
+  BOOST_CHECK_THROW(tree.findPointsWithinRadius(coords, radii, pool), Elements::Exception);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreePairCounts_test, RandomFixture) {
+  std::vector<DataNode> others(nodes.begin(), nodes.begin() + 700);
+  for (auto& n : others) {
+    n.m_coords[0] += 0.3;
+  }
+  KdTree::KdTree<DataNode, 3, 4> tree(nodes);
+  KdTree::KdTree<DataNode, 3, 4> other_tree(others);
+  Euclid::ThreadPool             pool{4};
+
+  const std::vector<double> edges{0., 0.1, 0.5, 1., 2.5, 4.};
+  std::vector<double>       square_edges;
+  for (double e : edges) {
+    square_edges.push_back(e * e);
+  }
+  auto bin = [&square_edges](const DataNode& a, const DataNode& b) -> ptrdiff_t {
+    double square_dist = 0;
+    for (size_t i = 0; i < 3; ++i) {
+      square_dist += (a.m_coords[i] - b.m_coords[i]) * (a.m_coords[i] - b.m_coords[i]);
+    }
+    return std::upper_bound(square_edges.begin(), square_edges.end(), square_dist) - square_edges.begin() - 1;
+  };
+
+  std::vector<size_t> expected_cross(edges.size() - 1), expected_self(edges.size() - 1);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    for (size_t j = 0; j < others.size(); ++j) {
+      auto k = bin(nodes[i], others[j]);
+      if (k >= 0 && k < static_cast<ptrdiff_t>(expected_cross.size())) {
+        ++expected_cross[k];
+      }
+    }
+    for (size_t j = i + 1; j < nodes.size(); ++j) {
+      auto k = bin(nodes[i], nodes[j]);
+      if (k >= 0 && k < static_cast<ptrdiff_t>(expected_self.size())) {
+        ++expected_self[k];
+      }
+    }
+  }
+
+  auto cross = tree.countPairs(other_tree, edges, pool);
+  BOOST_CHECK_EQUAL_COLLECTIONS(cross.begin(), cross.end(), expected_cross.begin(), expected_cross.end());
+  cross = other_tree.countPairs(tree, edges, pool);
+  BOOST_CHECK_EQUAL_COLLECTIONS(cross.begin(), cross.end(), expected_cross.begin(), expected_cross.end());
+  auto self = tree.countPairs(edges, pool);
+  BOOST_CHECK_EQUAL_COLLECTIONS(self.begin(), self.end(), expected_self.begin(), expected_self.end());
+  // The duplicated points are at distance zero
+  BOOST_CHECK_GE(self[0], nodes.size() / 10);
+
+  // More bins than the leaves check at once
+  std::vector<double> fine_edges;
+  for (int i = 0; i <= 2000; ++i) {
+    fine_edges.push_back(i * 0.002);
+  }
+  square_edges.clear();
+  for (double e : fine_edges) {
+    square_edges.push_back(e * e);
+  }
+  std::vector<size_t> expected_fine(fine_edges.size() - 1);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    for (size_t j = 0; j < others.size(); ++j) {
+      auto k = bin(nodes[i], others[j]);
+      if (k >= 0 && k < static_cast<ptrdiff_t>(expected_fine.size())) {
+        ++expected_fine[k];
+      }
+    }
+  }
+  auto fine = tree.countPairs(other_tree, fine_edges, pool);
+  BOOST_CHECK_EQUAL_COLLECTIONS(fine.begin(), fine.end(), expected_fine.begin(), expected_fine.end());
+
+  BOOST_CHECK_THROW(tree.countPairs(other_tree, std::vector<double>{1.}, pool), Elements::Exception);
+  BOOST_CHECK_THROW(tree.countPairs(std::vector<double>{1., 0.5}, pool), Elements::Exception);
+  BOOST_CHECK_THROW(tree.countPairs(std::vector<double>{-0.5, 1.}, pool), Elements::Exception);
+  BOOST_CHECK_THROW(tree.countPairs(std::vector<double>{0., std::nan(""), 1.}, pool), Elements::Exception);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreeGroups_test, RandomFixture) {
+  KdTree::KdTree<DataNode, 3, 4> tree(nodes);
+  Euclid::ThreadPool             pool{4};
+
+  for (double linking_length : {0.05, 0.3, 0.6}) {
+    // Brute force union-find
+    std::vector<size_t>           parent(nodes.size());
+    std::function<size_t(size_t)> find = [&parent, &find](size_t x) {
+      return parent[x] == x ? x : parent[x] = find(parent[x]);
+    };
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      parent[i] = i;
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      for (size_t j = i + 1; j < nodes.size(); ++j) {
+        double square_dist = 0;
+        for (size_t k = 0; k < 3; ++k) {
+          square_dist += (nodes[i].m_coords[k] - nodes[j].m_coords[k]) * (nodes[i].m_coords[k] - nodes[j].m_coords[k]);
+        }
+        if (square_dist < linking_length * linking_length) {
+          parent[std::max(find(i), find(j))] = std::min(find(i), find(j));
+        }
+      }
+    }
+
+    auto groups = tree.findGroups(linking_length, pool);
+    BOOST_REQUIRE_EQUAL(groups.size(), nodes.size());
+    // Same partition, with the groups numbered in order of appearance
+    std::vector<size_t> root_group(nodes.size(), nodes.size());
+    size_t              next = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      size_t root = find(i);
+      if (root_group[root] == nodes.size()) {
+        root_group[root] = next++;
+      }
+      BOOST_CHECK_EQUAL(groups[i], root_group[root]);
+    }
+  }
+
+  KdTree::KdTree<DataNode, 3, 4> empty({});
+  BOOST_CHECK(empty.findGroups(1., pool).empty());
+
+  BOOST_CHECK_THROW(tree.findGroups(0., pool), Elements::Exception);
+  BOOST_CHECK_THROW(tree.findGroups(-0.3, pool), Elements::Exception);
+  BOOST_CHECK_THROW(tree.findGroups(std::nan(""), pool), Elements::Exception);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreeRadiusVariants_test, RandomFixture) {
+  KdTree::KdTree<DataNode, 3, 4> tree(nodes);
+
+  std::mt19937                     generator{3};
+  std::uniform_real_distribution<> uniform{0., 10.};
+  std::vector<DataNode>            buffer;
+  for (int q = 0; q < 100; ++q) {
+    std::array<double, 3> coord{uniform(generator), uniform(generator), uniform(generator)};
+    double                radius   = uniform(generator) / 4;
+    auto                  expected = bruteForce(coord, radius);
+
+    tree.findPointsWithinRadius({coord[0], coord[1], coord[2]}, radius, buffer);
+    auto found = sortedLabels(buffer);
+    BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+
+    std::vector<DataNode> output(expected.size() + 1);
+    auto end = tree.findPointsWithinRadius({coord[0], coord[1], coord[2]}, radius, output.begin());
+    BOOST_CHECK_EQUAL(end - output.begin(), expected.size());
+    output.erase(end, output.end());
+    found = sortedLabels(output);
+    BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+
+    std::vector<std::string> visited;
+    tree.forEachPointWithinRadius({coord[0], coord[1], coord[2]}, radius,
+                                  [&visited](const DataNode& n) { visited.push_back(n.m_label); });
+    std::sort(visited.begin(), visited.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(visited.begin(), visited.end(), expected.begin(), expected.end());
+
+    BOOST_CHECK_EQUAL(tree.countPointsWithinRadius({coord[0], coord[1], coord[2]}, radius), expected.size());
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreeNearest_test, KdTreeFixture) {
+  KdTree::KdTree<DataNode, 3> tree(nodes);
+
+  auto nearest = tree.findNearest({1.1, 1., 1.});
+  BOOST_CHECK_EQUAL(nearest.point.m_label, "=");
+  BOOST_CHECK_CLOSE(nearest.distance, 0.1, 1e-8);
+
+  auto neighbors = tree.findNearest({1.1, 1., 1.}, 3);
+  BOOST_REQUIRE_EQUAL(neighbors.size(), 3);
+  BOOST_CHECK_EQUAL(neighbors[0].point.m_label, "=");
+  BOOST_CHECK_CLOSE(neighbors[0].distance, 0.1, 1e-8);
+  for (size_t i = 1; i < neighbors.size(); ++i) {
+    BOOST_CHECK_LE(neighbors[i - 1].distance, neighbors[i].distance);
+  }
+
+  // Asking for more neighbours than points returns all of them
+  neighbors = tree.findNearest({1.1, 1., 1.}, nodes.size() + 10);
+  BOOST_CHECK_EQUAL(neighbors.size(), nodes.size());
+  BOOST_CHECK(tree.findNearest({1.1, 1., 1.}, 0).empty());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(KdTreeNearestEmpty_test) {
+  KdTree::KdTree<DataNode> tree({});
+  BOOST_CHECK(tree.findNearest({1., 1.}, 5).empty());
+  BOOST_CHECK_THROW(tree.findNearest({1., 1.}), Elements::Exception);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreeNearestRandom_test, RandomFixture) {
+  KdTree::KdTree<DataNode, 3, 4> small_leaves(nodes);
+  KdTree::KdTree<DataNode, 3>    big_leaves(nodes);
+
+  std::mt19937                     generator{7};
+  std::uniform_real_distribution<> uniform{-1., 11.};
+  for (int q = 0; q < 200; ++q) {
+    std::array<double, 3> coord{uniform(generator), uniform(generator), uniform(generator)};
+    auto                  expected = sortedDistances(coord);
+
+    for (size_t k : {1, 2, 10, 57}) {
+      checkDistances(small_leaves.findNearest({coord[0], coord[1], coord[2]}, k), expected, k);
+      checkDistances(big_leaves.findNearest({coord[0], coord[1], coord[2]}, k), expected, k);
+    }
+    BOOST_CHECK_CLOSE(small_leaves.findNearest({coord[0], coord[1], coord[2]}).distance, expected[0], 1e-8);
+    BOOST_CHECK_CLOSE(big_leaves.findNearest({coord[0], coord[1], coord[2]}).distance, expected[0], 1e-8);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreeBox_test, RandomFixture) {
+  KdTree::KdTree<DataNode, 3, 4> tree(nodes);
+
+  std::mt19937                     generator{5};
+  std::uniform_real_distribution<> uniform{-1., 11.};
+  for (int q = 0; q < 200; ++q) {
+    std::array<double, 3> min, max;
+    for (size_t j = 0; j < 3; ++j) {
+      double a = uniform(generator), b = uniform(generator);
+      min[j] = std::min(a, b);
+      max[j] = std::max(a, b);
+    }
+    std::vector<std::string> expected;
+    for (auto& n : nodes) {
+      bool inside = true;
+      for (size_t j = 0; j < 3; ++j) {
+        inside &= (n.m_coords[j] >= min[j] && n.m_coords[j] <= max[j]);
+      }
+      if (inside) {
+        expected.push_back(n.m_label);
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+    auto found = sortedLabels(tree.findPointsInBox({min[0], min[1], min[2]}, {max[0], max[1], max[2]}));
+    BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+  }
+
+  // The faces are inside, so a box around a single point finds it
+  auto& c = nodes[123].m_coords;
+  auto  single = sortedLabels(tree.findPointsInBox({c[0], c[1], c[2]}, {c[0], c[1], c[2]}));
+  BOOST_CHECK(std::find(single.begin(), single.end(), "123") != single.end());
+  BOOST_CHECK_EQUAL(tree.findPointsInBox({-1., -1., -1.}, {11., 11., 11.}).size(), nodes.size());
+  BOOST_CHECK(tree.findPointsInBox({5., 5., 5.}, {4., 6., 6.}).empty());
+  BOOST_CHECK((KdTree::KdTree<DataNode, 3>({}).findPointsInBox({0., 0., 0.}, {1., 1., 1.}).empty()));
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreeApproximateNearest_test, RandomFixture) {
+  KdTree::KdTree<DataNode, 3, 4> tree(nodes);
+
+  std::mt19937                     generator{9};
+  std::uniform_real_distribution<> uniform{-1., 11.};
+  for (int q = 0; q < 200; ++q) {
+    std::array<double, 3> coord{uniform(generator), uniform(generator), uniform(generator)};
+    auto                  expected = sortedDistances(coord);
+
+    checkDistances(tree.findNearest({coord[0], coord[1], coord[2]}, 10, 0.), expected, 10);
+    for (double epsilon : {0.1, 0.5, 2.}) {
+      auto neighbors = tree.findNearest({coord[0], coord[1], coord[2]}, 10, epsilon);
+      BOOST_REQUIRE_EQUAL(neighbors.size(), 10);
+      for (size_t i = 0; i < neighbors.size(); ++i) {
+        BOOST_CHECK_LE(neighbors[i].distance, (1 + epsilon) * expected[i] * (1 + 1e-12));
+        if (i > 0) {
+          BOOST_CHECK_LE(neighbors[i - 1].distance, neighbors[i].distance);
+        }
+      }
+    }
+  }
+  BOOST_CHECK_THROW(tree.findNearest({1., 1., 1.}, 10, -0.1), Elements::Exception);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(KdTreePersistence_test, RandomFixture) {
+  Elements::TempFile file("kdtree_%%%%.bin");
+  Elements::TempFile other_file("kdtree_%%%%.bin");
+
+  std::vector<IndexedPoint> points(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    points[i] = {{nodes[i].m_coords[0], nodes[i].m_coords[1], nodes[i].m_coords[2]}, i};
+  }
+  Euclid::ThreadPool pool{2};
+  std::vector<size_t> groups;
+  std::vector<size_t> pairs;
+  {
+    KdTree::KdTree<IndexedPoint, 3, 4> built(points);
+    groups = built.findGroups(0.3, pool);
+    pairs  = built.countPairs(std::vector<double>{0.1, 0.5, 1.}, pool);
+    built.save(file.path().native());
+  }
+  // The built tree is gone, the opened one only depends on the file
+  auto opened = KdTree::KdTree<IndexedPoint, 3, 4>::open(file.path().native());
+  BOOST_REQUIRE_EQUAL(opened.size(), points.size());
+
+  std::mt19937                     generator{11};
+  std::uniform_real_distribution<> uniform{-1., 11.};
+  for (int q = 0; q < 50; ++q) {
+    std::array<double, 3> coord{uniform(generator), uniform(generator), uniform(generator)};
+    auto                  expected = bruteForce(coord, 1.5);
+    std::vector<std::string> found;
+    for (auto& p : opened.findPointsWithinRadius({coord[0], coord[1], coord[2]}, 1.5)) {
+      found.push_back(nodes[p.m_index].m_label);
+    }
+    std::sort(found.begin(), found.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+    checkDistances(opened.findNearest({coord[0], coord[1], coord[2]}, 5), sortedDistances(coord), 5);
+  }
+  auto opened_groups = opened.findGroups(0.3, pool);
+  BOOST_CHECK_EQUAL_COLLECTIONS(opened_groups.begin(), opened_groups.end(), groups.begin(), groups.end());
+  auto opened_pairs = opened.countPairs(std::vector<double>{0.1, 0.5, 1.}, pool);
+  BOOST_CHECK_EQUAL_COLLECTIONS(opened_pairs.begin(), opened_pairs.end(), pairs.begin(), pairs.end());
+
+  // A different leaf size is a different type
+  BOOST_CHECK_THROW((KdTree::KdTree<IndexedPoint, 3, 8>::open(file.path().native())), Elements::Exception);
+  BOOST_CHECK_THROW((KdTree::KdTree<IndexedPoint, 2, 4>::open(file.path().native())), Elements::Exception);
+
+  // Empty trees can be saved too
+  KdTree::KdTree<IndexedPoint, 3, 4>({}).save(other_file.path().native());
+  auto empty = KdTree::KdTree<IndexedPoint, 3, 4>::open(other_file.path().native());
+  BOOST_CHECK_EQUAL(empty.size(), 0);
+  BOOST_CHECK(empty.findPointsWithinRadius({1., 1., 1.}, 100.).empty());
+
+  // Flip one byte of the coordinates
+  std::vector<char> content;
+  {
+    std::ifstream in{file.path().native(), std::ios::binary};
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  content[content.size() / 2] ^= 1;
+  {
+    std::ofstream out{other_file.path().native(), std::ios::binary};
+    out.write(content.data(), content.size());
+  }
+  BOOST_CHECK_THROW((KdTree::KdTree<IndexedPoint, 3, 4>::open(other_file.path().native())), Elements::Exception);
+  BOOST_CHECK_NO_THROW((KdTree::KdTree<IndexedPoint, 3, 4>::open(other_file.path().native(), false)));
+
+  // Truncated
+  {
+    std::ofstream out{other_file.path().native(), std::ios::binary};
+    out.write(content.data(), content.size() - 64);
+  }
+  BOOST_CHECK_THROW((KdTree::KdTree<IndexedPoint, 3, 4>::open(other_file.path().native(), false)),
+                    Elements::Exception);
+
+  // Not a tree
+  {
+    std::ofstream out{other_file.path().native(), std::ios::binary};
+    out << std::string(1024, 'x');
+  }
+  BOOST_CHECK_THROW((KdTree::KdTree<IndexedPoint, 3, 4>::open(other_file.path().native())), Elements::Exception);
+  BOOST_CHECK_THROW((KdTree::KdTree<IndexedPoint, 3, 4>::open("/does/not/exist")), Elements::Exception);
+}
+
+//-----------------------------------------------------------------------------
+
 BOOST_AUTO_TEST_SUITE_END()
 
 //-----------------------------------------------------------------------------
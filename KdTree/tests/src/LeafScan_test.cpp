@@ -0,0 +1,116 @@
+/**
+ * @copyright (C) 2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#include "KdTree/LeafScan.h"
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include <vector>
+
+using namespace KdTree;
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+/// The positions of the matching points, computed one by one
+std::vector<uint32_t> bruteForce(const std::vector<std::vector<double>>& axes, size_t count, const double* coord,
+                                 double square_radius) {
+  std::vector<uint32_t> expected;
+  for (size_t i = 0; i < count; ++i) {
+    double square_dist = 0;
+    for (size_t j = 0; j < axes.size(); ++j) {
+      square_dist += (axes[j][i] - coord[j]) * (axes[j][i] - coord[j]);
+    }
+    if (square_dist < square_radius) {
+      expected.push_back(i);
+    }
+  }
+  return expected;
+}
+
+}  // namespace
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(LeafScan_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(Kernels_test) {
+  std::mt19937                     generator{42};
+  std::uniform_real_distribution<> uniform{-1., 1.};
+
+  BOOST_CHECK(isSupported(LeafScanKernel::Scalar));
+  BOOST_CHECK(isSupported(defaultLeafScanKernel()));
+
+  for (auto kernel : {LeafScanKernel::Scalar, LeafScanKernel::AVX2, LeafScanKernel::AVX512}) {
+    if (!isSupported(kernel)) {
+      BOOST_TEST_MESSAGE("Kernel " << static_cast<int>(kernel) << " not supported, skipping");
+      continue;
+    }
+    for (size_t dimensions : {1, 2, 3, 5}) {
+      std::vector<std::vector<double>> axes(dimensions, std::vector<double>(LEAF_SCAN_BLOCK));
+      std::vector<const double*>       pointers;
+      for (auto& axis : axes) {
+        for (auto& c : axis) {
+          c = uniform(generator);
+        }
+        pointers.push_back(axis.data());
+      }
+      std::vector<double> coord(dimensions);
+      for (auto& c : coord) {
+        c = uniform(generator) / 2;
+      }
+
+      // All the sizes, so every kernel goes through its remainder handling
+      for (size_t count = 0; count <= LEAF_SCAN_BLOCK; ++count) {
+        std::vector<uint32_t> found(LEAF_SCAN_BLOCK);
+        auto nfound = scanLeaf(kernel, pointers.data(), dimensions, count, coord.data(), 0.5, found.data());
+        found.resize(nfound);
+        auto expected = bruteForce(axes, count, coord.data(), 0.5);
+        BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(Boundary_test) {
+  // The points exactly at the radius do not match, whatever the kernel
+  std::vector<double> x{0., 1., 0.5, -1., 2., 0., 0., 1.};
+  std::vector<double> y{1., 0., 0.5, 0., 0., -1., 0., 0.};
+  const double*       axes[] = {x.data(), y.data()};
+  const double        coord[] = {0., 0.};
+
+  for (auto kernel : {LeafScanKernel::Scalar, LeafScanKernel::AVX2, LeafScanKernel::AVX512}) {
+    if (isSupported(kernel)) {
+      uint32_t found[8];
+      BOOST_CHECK_EQUAL(scanLeaf(kernel, axes, 2, x.size(), coord, 1., found), 2);
+      BOOST_CHECK_EQUAL(found[0], 2);
+      BOOST_CHECK_EQUAL(found[1], 6);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//-----------------------------------------------------------------------------
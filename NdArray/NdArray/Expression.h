@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file NdArray/Expression.h
+ * @date 16/10/26
+ * @author nikoapos
+ *
+ * Element-wise arithmetic on NdArray with expression templates. The operators and the
+ * math functions below do not compute anything: they return a lightweight object
+ * describing the operation, which keeps pointers to the data of the arrays involved.
+ * The whole expression is evaluated when it is assigned to an NdArray (or used to
+ * construct one), in a single loop over the elements, without any temporary array:
+ *
+ *   NdArray<double> result = a * b + 2 * exp(-c);
+ *   result += a.rslice(0);
+ *
+ * The operands must have the same shape, or be scalars, which are broadcast to all
+ * the elements. Views created with slice() and rslice() can appear on both sides of
+ * the assignment; their strides are respected. When all the operands and the
+ * destination are contiguous the loop accesses the memory linearly, so the compiler
+ * can vectorize it.
+ *
+ * @note
+ *   The expressions refer to the arrays, they do not own them. They must be
+ *   evaluated while the arrays are alive (typically in the same statement).
+ */
+
+#ifndef ALEXANDRIA_NDARRAY_EXPRESSION_H
+#define ALEXANDRIA_NDARRAY_EXPRESSION_H
+
+#include "NdArray/NdArray.h"
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Euclid {
+namespace NdArray {
+
+/**
+ * Base class (CRTP) of all the element-wise expressions
+ * @details
+ *  Every expression provides:
+ *  - value_type, the type of its elements
+ *  - shape(), a pointer to its shape, or nullptr for scalars
+ *  - contiguous(), true if its element i can be read at position i of its operands
+ *  - get<Contiguous>(i), the element i, where Contiguous can be true only if contiguous() is
+ */
+template <typename Derived>
+struct Expression {
+  const Derived& derived() const {
+    return static_cast<const Derived&>(*this);
+  }
+};
+
+namespace Expression_Impl {
+
+/// An NdArray used as an operand, read through its data pointer and stride
+template <typename T>
+class ArrayOperand : public Expression<ArrayOperand<T>> {
+public:
+  using value_type = T;
+
+  explicit ArrayOperand(const NdArray<T>& array)
+      : m_data(array.m_container->m_data_ptr + array.m_offset)
+      , m_stride(array.m_stride_size.empty() ? 1 : array.m_stride_size.back())
+      , m_shape(&array.m_shape) {}
+
+  const std::vector<size_t>* shape() const {
+    return m_shape;
+  }
+
+  bool contiguous() const {
+    return m_stride == 1;
+  }
+
+  template <bool Contiguous>
+  T get(size_t i) const {
+    return Contiguous ? m_data[i] : m_data[i * m_stride];
+  }
+
+private:
+  const T*                   m_data;
+  size_t                     m_stride;
+  const std::vector<size_t>* m_shape;
+};
+
+/// A scalar operand, broadcast to all the elements
+template <typename T>
+class ScalarOperand : public Expression<ScalarOperand<T>> {
+public:
+  using value_type = T;
+
+  explicit ScalarOperand(T value) : m_value(value) {}
+
+  const std::vector<size_t>* shape() const {
+    return nullptr;
+  }
+
+  bool contiguous() const {
+    return true;
+  }
+
+  template <bool Contiguous>
+  T get(size_t) const {
+    return m_value;
+  }
+
+private:
+  T m_value;
+};
+
+/// Applies Op to the elements of an expression
+template <typename Op, typename E>
+class UnaryExpression : public Expression<UnaryExpression<Op, E>> {
+public:
+  using value_type = decltype(std::declval<Op>()(std::declval<typename E::value_type>()));
+
+  explicit UnaryExpression(const E& operand) : m_operand(operand) {}
+
+  const std::vector<size_t>* shape() const {
+    return m_operand.shape();
+  }
+
+  bool contiguous() const {
+    return m_operand.contiguous();
+  }
+
+  template <bool Contiguous>
+  value_type get(size_t i) const {
+    return Op()(m_operand.template get<Contiguous>(i));
+  }
+
+private:
+  E m_operand;
+};
+
+/// Applies Op to the pairs of elements of two expressions
+template <typename Op, typename L, typename R>
+class BinaryExpression : public Expression<BinaryExpression<Op, L, R>> {
+public:
+  using value_type =
+      decltype(std::declval<Op>()(std::declval<typename L::value_type>(), std::declval<typename R::value_type>()));
+
+  /// @throws std::length_error If both operands have a shape, and they are different
+  BinaryExpression(const L& left, const R& right) : m_left(left), m_right(right) {
+    if (left.shape() && right.shape() && *left.shape() != *right.shape()) {
+      throw std::length_error("The operands of an element-wise operation must have the same shape");
+    }
+  }
+
+  const std::vector<size_t>* shape() const {
+    return m_left.shape() ? m_left.shape() : m_right.shape();
+  }
+
+  bool contiguous() const {
+    return m_left.contiguous() && m_right.contiguous();
+  }
+
+  template <bool Contiguous>
+  value_type get(size_t i) const {
+    return Op()(m_left.template get<Contiguous>(i), m_right.template get<Contiguous>(i));
+  }
+
+private:
+  L m_left;
+  R m_right;
+};
+
+/// Maps the types accepted by the operators to the expression used as operand.
+/// There is no type member for the other types, so the operators do not apply to them.
+template <typename X, typename Enable = void>
+struct Operand {};
+
+template <typename T>
+struct Operand<NdArray<T>> {
+  using type = ArrayOperand<T>;
+  static const bool is_scalar = false;
+  static type make(const NdArray<T>& array) {
+    return type(array);
+  }
+};
+
+template <typename X>
+struct Operand<X, typename std::enable_if<std::is_base_of<Expression<X>, X>::value>::type> {
+  using type = X;
+  static const bool is_scalar = false;
+  static const X& make(const X& expression) {
+    return expression;
+  }
+};
+
+template <typename X>
+struct Operand<X, typename std::enable_if<std::is_arithmetic<X>::value>::type> {
+  using type = ScalarOperand<X>;
+  static const bool is_scalar = true;
+  static type make(X value) {
+    return type(value);
+  }
+};
+
+/// The type returned by an unary operation on X, only defined if X is an array or an expression
+template <typename Op, typename X, typename Enable = void>
+struct UnaryResult {};
+
+template <typename Op, typename X>
+struct UnaryResult<Op, X, typename std::enable_if<!Operand<X>::is_scalar>::type> {
+  using type = UnaryExpression<Op, typename Operand<X>::type>;
+};
+
+/// The type returned by a binary operation on L and R, only defined if at least one of them
+/// is an array or an expression, and the other one is an array, an expression or a scalar
+template <typename Op, typename L, typename R, typename Enable = void>
+struct BinaryResult {};
+
+template <typename Op, typename L, typename R>
+struct BinaryResult<Op, L, R, typename std::enable_if<!(Operand<L>::is_scalar && Operand<R>::is_scalar)>::type> {
+  using type = BinaryExpression<Op, typename Operand<L>::type, typename Operand<R>::type>;
+};
+
+struct Plus {
+  template <typename A, typename B>
+  auto operator()(A a, B b) const -> decltype(a + b) {
+    return a + b;
+  }
+};
+
+struct Minus {
+  template <typename A, typename B>
+  auto operator()(A a, B b) const -> decltype(a - b) {
+    return a - b;
+  }
+};
+
+struct Multiplies {
+  template <typename A, typename B>
+  auto operator()(A a, B b) const -> decltype(a * b) {
+    return a * b;
+  }
+};
+
+struct Divides {
+  template <typename A, typename B>
+  auto operator()(A a, B b) const -> decltype(a / b) {
+    return a / b;
+  }
+};
+
+struct Negate {
+  template <typename A>
+  auto operator()(A a) const -> decltype(-a) {
+    return -a;
+  }
+};
+
+struct Pow {
+  template <typename A, typename B>
+  auto operator()(A a, B b) const -> decltype(std::pow(a, b)) {
+    return std::pow(a, b);
+  }
+};
+
+}  // namespace Expression_Impl
+
+/// @name Element-wise operators
+/// At least one of the operands must be an NdArray or an expression, the other one can be a scalar
+/// @{
+
+template <typename L, typename R>
+typename Expression_Impl::BinaryResult<Expression_Impl::Plus, L, R>::type operator+(const L& left, const R& right);
+
+template <typename L, typename R>
+typename Expression_Impl::BinaryResult<Expression_Impl::Minus, L, R>::type operator-(const L& left, const R& right);
+
+template <typename L, typename R>
+typename Expression_Impl::BinaryResult<Expression_Impl::Multiplies, L, R>::type operator*(const L& left,
+                                                                                           const R& right);
+
+template <typename L, typename R>
+typename Expression_Impl::BinaryResult<Expression_Impl::Divides, L, R>::type operator/(const L& left, const R& right);
+
+template <typename X>
+typename Expression_Impl::UnaryResult<Expression_Impl::Negate, X>::type operator-(const X& operand);
+
+/// Raises each element of base to the power of the corresponding element of exponent
+template <typename L, typename R>
+typename Expression_Impl::BinaryResult<Expression_Impl::Pow, L, R>::type pow(const L& base, const R& exponent);
+
+/// @}
+
+/**
+ * Declares an element-wise math function, applying the function of the same name from <cmath>
+ */
+#define NDARRAY_UNARY_FUNCTION(name)                                                              \
+  namespace Expression_Impl {                                                                     \
+  struct name##_op {                                                                              \
+    template <typename A>                                                                         \
+    auto operator()(A a) const -> decltype(std::name(a)) {                                        \
+      return std::name(a);                                                                        \
+    }                                                                                             \
+  };                                                                                              \
+  }                                                                                               \
+  template <typename X>                                                                           \
+  typename Expression_Impl::UnaryResult<Expression_Impl::name##_op, X>::type name(const X& operand) { \
+    using Result = typename Expression_Impl::UnaryResult<Expression_Impl::name##_op, X>::type;    \
+    return Result(Expression_Impl::Operand<X>::make(operand));                                    \
+  }
+
+/// @name Element-wise math functions
+/// @{
+NDARRAY_UNARY_FUNCTION(abs)
+NDARRAY_UNARY_FUNCTION(sqrt)
+NDARRAY_UNARY_FUNCTION(cbrt)
+NDARRAY_UNARY_FUNCTION(exp)
+NDARRAY_UNARY_FUNCTION(log)
+NDARRAY_UNARY_FUNCTION(log10)
+NDARRAY_UNARY_FUNCTION(sin)
+NDARRAY_UNARY_FUNCTION(cos)
+NDARRAY_UNARY_FUNCTION(tan)
+NDARRAY_UNARY_FUNCTION(asin)
+NDARRAY_UNARY_FUNCTION(acos)
+NDARRAY_UNARY_FUNCTION(atan)
+/// @}
+
+#undef NDARRAY_UNARY_FUNCTION
+
+}  // namespace NdArray
+}  // namespace Euclid
+
+#define NDARRAY_EXPRESSION_IMPL
+#include "NdArray/_impl/Expression.icpp"
+#undef NDARRAY_EXPRESSION_IMPL
+
+#endif  // ALEXANDRIA_NDARRAY_EXPRESSION_H
@@ -35,6 +35,19 @@
 namespace Euclid {
 namespace NdArray {
 
+template <typename Derived>
+struct Expression;
+
+namespace Expression_Impl {
+template <typename T>
+class ArrayOperand;
+}
+
+namespace Operations_Impl {
+template <typename T>
+struct AxisLayout;
+}
+
 /**
  * Stores a multidimensional array in a contiguous piece of memory in row-major order
  * @tparam T
@@ -280,6 +293,50 @@ public:
    */
   NdArray& operator=(const NdArray&) = default;
 
+  /**
+   * Constructs a matrix with the shape of the given expression, and evaluates it
+   * @see NdArray/Expression.h
+   */
+  template <typename E>
+  NdArray(const Expression<E>& expression);
+
+  /**
+   * Evaluates an element-wise expression, writing the result into the elements of this array
+   * @note
+   *    Unlike the assignment from another NdArray, this modifies the underlying data, which
+   *    can be shared with other arrays (i.e. when this is a slice). This array can appear in
+   *    the expression, as each element is only read to compute the same element.
+   * @throws std::length_error
+   *    If the shape of the expression is not the same as the shape of this array
+   * @see NdArray/Expression.h
+   */
+  template <typename E>
+  NdArray& operator=(const Expression<E>& expression);
+
+  /**
+   * Adds, element-wise, an NdArray, an expression or a scalar to this array, in place
+   */
+  template <typename X>
+  NdArray& operator+=(const X& other);
+
+  /**
+   * Subtracts, element-wise, an NdArray, an expression or a scalar from this array, in place
+   */
+  template <typename X>
+  NdArray& operator-=(const X& other);
+
+  /**
+   * Multiplies, element-wise, this array by an NdArray, an expression or a scalar, in place
+   */
+  template <typename X>
+  NdArray& operator*=(const X& other);
+
+  /**
+   * Divides, element-wise, this array by an NdArray, an expression or a scalar, in place
+   */
+  template <typename X>
+  NdArray& operator/=(const X& other);
+
   /**
    * Create a copy of the NdArray
    */
@@ -461,6 +518,11 @@ public:
   const std::vector<std::string>& attributes() const;
 
 private:
+  template <typename>
+  friend class Expression_Impl::ArrayOperand;
+  template <typename>
+  friend struct Operations_Impl::AxisLayout;
+
   size_t                   m_offset;
   std::vector<size_t>      m_shape, m_stride_size;
   std::vector<std::string> m_attr_names;
@@ -620,4 +682,6 @@ std::ostream& operator<<(std::ostream& out, const NdArray<T>& ndarray);
 #include "NdArray/_impl/NdArray.icpp"
 #undef NDARRAY_IMPL
 
+#include "NdArray/Expression.h"
+
 #endif  // ALEXANDRIA_NDARRAY_H
@@ -20,6 +20,9 @@
 #define ALEXANDRIA_NDARRAY_OPERATIONS_H
 
 #include "NdArray/NdArray.h"
+#include "NdArray/ReductionKernels.h"
+#include <algorithm>
+#include <functional>
 
 namespace Euclid {
 namespace NdArray {
@@ -57,6 +60,90 @@ T sum(const NdArray<T>& array);
 template <typename T>
 NdArray<T> sum(const NdArray<T>& array, int axis);
 
+/**
+ * Average of the elements in an ndarray along the given axis
+ * @param array
+ *  The ndarray
+ * @param axis
+ *  The axis. 0 is the first. Negative values index from the end.
+ * @return
+ *  Another NdArray with one axis less. For integral types, the mean is truncated as by an integer division.
+ * @throw std::length_error
+ *  If the axis is empty
+ */
+template <typename T>
+NdArray<T> mean(const NdArray<T>& array, int axis);
+
+/**
+ * Minimum of the elements in an ndarray along the given axis
+ * @param array
+ *  The ndarray
+ * @param axis
+ *  The axis. 0 is the first. Negative values index from the end.
+ * @return
+ *  Another NdArray with one axis less
+ * @throw std::length_error
+ *  If the axis is empty
+ */
+template <typename T>
+NdArray<T> min(const NdArray<T>& array, int axis);
+
+/**
+ * Maximum of the elements in an ndarray along the given axis
+ * @param array
+ *  The ndarray
+ * @param axis
+ *  The axis. 0 is the first. Negative values index from the end.
+ * @return
+ *  Another NdArray with one axis less
+ * @throw std::length_error
+ *  If the axis is empty
+ */
+template <typename T>
+NdArray<T> max(const NdArray<T>& array, int axis);
+
+/**
+ * Variance of the elements in an ndarray along the given axis
+ * @param array
+ *  The ndarray
+ * @param axis
+ *  The axis. 0 is the first. Negative values index from the end.
+ * @return
+ *  Another NdArray with one axis less, with the population variance
+ *  (the mean of the squared deviations from the mean)
+ * @throw std::length_error
+ *  If the axis is empty
+ */
+template <typename T>
+NdArray<T> var(const NdArray<T>& array, int axis);
+
+/**
+ * Cumulative sum of the elements in an ndarray along the given axis
+ * @param array
+ *  The ndarray
+ * @param axis
+ *  The axis. 0 is the first. Negative values index from the end.
+ * @return
+ *  Another NdArray with the same shape
+ */
+template <typename T>
+NdArray<T> cumsum(const NdArray<T>& array, int axis);
+
+/**
+ * Return the positions of the maximum elements along the given axis
+ * @param array
+ *  The ndarray
+ * @param axis
+ *  The axis. 0 is the first. Negative values index from the end.
+ * @return
+ *  Another NdArray with one axis less, with the index along the axis of the
+ *  maximum. If it appears more than once, the first one.
+ * @throw std::length_error
+ *  If the axis is empty
+ */
+template <typename T>
+NdArray<std::size_t> argmax(const NdArray<T>& array, int axis);
+
 /**
  * Integrate elements in an ndarray along the given axis
  * @param array
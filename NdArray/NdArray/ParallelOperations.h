@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file NdArray/ParallelOperations.h
+ * @date 16/10/26
+ * @author nikoapos
+ *
+ * Versions of the operations of NdArray/Operations.h executed by the threads of a
+ * Euclid::ThreadPool. They have the same semantics and throw the same exceptions
+ * as the serial ones.
+ *
+ * The reductions along an axis split the positions before and after the axis in
+ * tiles, and each output element is computed by a single thread, as the serial
+ * version does, so the result is identical. The full-array reductions split the
+ * elements in blocks of PARALLEL_MIN_SIZE, which do not depend on the number of
+ * threads, and combine the blocks in order, so the result of sum() is the same
+ * for any pool (but it may differ from the serial one in the last bits).
+ *
+ * Arrays with less than PARALLEL_MIN_SIZE elements are processed serially by the
+ * calling thread, as the cost of dispatching the work would dominate.
+ * The functions block until the work is done. They can be called from a task
+ * running on the same pool.
+ */
+
+#ifndef ALEXANDRIA_NDARRAY_PARALLELOPERATIONS_H
+#define ALEXANDRIA_NDARRAY_PARALLELOPERATIONS_H
+
+#include "AlexandriaKernel/Parallel.h"
+#include "AlexandriaKernel/ThreadPool.h"
+#include "NdArray/Operations.h"
+#include <type_traits>
+#include <utility>
+
+namespace Euclid {
+namespace NdArray {
+
+/// Arrays with less elements are processed serially. It is also the size of the
+/// blocks of the full-array reductions.
+constexpr std::size_t PARALLEL_MIN_SIZE = 1 << 16;
+
+/**
+ * Sum all elements in an ndarray
+ * @param pool
+ *  The pool executing the blocks
+ * @param array
+ *  The ndarray
+ */
+template <typename T>
+T sum(ThreadPool& pool, const NdArray<T>& array);
+
+/**
+ * Return the coordinates for the maximum element. If it appears more than once, the first one.
+ * @param pool
+ *  The pool executing the blocks
+ * @param array
+ *  The ndarray
+ */
+template <typename T>
+std::vector<std::size_t> argmax(ThreadPool& pool, const NdArray<T>& array);
+
+/**
+ * Return the coordinates for the minimum element. If it appears more than once, the first one.
+ * @param pool
+ *  The pool executing the blocks
+ * @param array
+ *  The ndarray
+ */
+template <typename T>
+std::vector<std::size_t> argmin(ThreadPool& pool, const NdArray<T>& array);
+
+/// @name Reductions along an axis
+/// See the serial versions in NdArray/Operations.h
+/// @{
+
+template <typename T>
+NdArray<T> sum(ThreadPool& pool, const NdArray<T>& array, int axis);
+
+template <typename T>
+NdArray<T> mean(ThreadPool& pool, const NdArray<T>& array, int axis);
+
+template <typename T>
+NdArray<T> min(ThreadPool& pool, const NdArray<T>& array, int axis);
+
+template <typename T>
+NdArray<T> max(ThreadPool& pool, const NdArray<T>& array, int axis);
+
+template <typename T>
+NdArray<T> var(ThreadPool& pool, const NdArray<T>& array, int axis);
+
+template <typename T>
+NdArray<T> cumsum(ThreadPool& pool, const NdArray<T>& array, int axis);
+
+template <typename T>
+NdArray<std::size_t> argmax(ThreadPool& pool, const NdArray<T>& array, int axis);
+
+template <typename T, typename Iterator>
+NdArray<T> trapz(ThreadPool& pool, const NdArray<T>& array, const Iterator kbegin, const Iterator kend, int axis);
+
+/// @}
+
+/**
+ * Apply a function to every element of an ndarray
+ * @param pool
+ *  The pool executing the blocks
+ * @param array
+ *  The ndarray
+ * @param func
+ *  Called with each element. It is called concurrently, so it must be thread safe.
+ * @return
+ *  A new, contiguous, NdArray with the same shape and the results
+ */
+template <typename T, typename Function>
+NdArray<typename std::decay<decltype(std::declval<Function&>()(std::declval<const T&>()))>::type>
+transform(ThreadPool& pool, const NdArray<T>& array, Function func);
+
+/**
+ * Evaluate an element-wise expression (see NdArray/Expression.h) into an ndarray,
+ * like NdArray::operator= does
+ * @param pool
+ *  The pool executing the blocks
+ * @param destination
+ *  The ndarray, or a slice of one, receiving the result
+ * @param expression
+ *  The expression, which must have the shape of the destination
+ * @return
+ *  destination
+ * @throw std::length_error
+ *  If the shapes do not match
+ */
+template <typename T, typename E>
+NdArray<T>& evaluate(ThreadPool& pool, NdArray<T>& destination, const Expression<E>& expression);
+
+}  // namespace NdArray
+}  // namespace Euclid
+
+#define NDARRAY_PARALLEL_OPS_IMPL
+#include "NdArray/_impl/ParallelOperations.icpp"
+#undef NDARRAY_PARALLEL_OPS_IMPL
+
+#endif  // ALEXANDRIA_NDARRAY_PARALLELOPERATIONS_H
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file NdArray/ReductionKernels.h
+ * @date 16/10/26
+ * @author nikoapos
+ *
+ * Kernels for the full-array reductions (sum, argmax and argmin) over float and double
+ * elements. Contiguous elements are processed with SIMD instructions, using the widest
+ * instruction set the CPU supports, which is detected at runtime. Elements separated by
+ * a stride are processed by the scalar code.
+ */
+
+#ifndef ALEXANDRIA_NDARRAY_REDUCTIONKERNELS_H
+#define ALEXANDRIA_NDARRAY_REDUCTIONKERNELS_H
+
+#include <cstddef>
+
+namespace Euclid {
+namespace NdArray {
+
+/// Number of elements summed sequentially before their sums are added pairwise
+constexpr std::size_t PAIRWISE_BLOCK = 256;
+
+/// The implementations of the reduction kernels
+enum class ReductionKernel { Scalar, SSE2, AVX2, AVX512 };
+
+/// Returns true if the CPU the program runs on can execute the given kernel
+bool isSupported(ReductionKernel kernel);
+
+/// Returns the fastest kernel supported by the CPU, which is the one used by default
+ReductionKernel defaultReductionKernel();
+
+/**
+ * Sum of count elements
+ * @details
+ * The elements are split in blocks of PAIRWISE_BLOCK, each summed with several
+ * accumulators, and the sums of the blocks are added pairwise, as the leaves of a
+ * binary tree. The rounding error grows with the logarithm of count instead of
+ * linearly, so the sum stays accurate for billions of elements. Different kernels
+ * give the same result up to the last bits.
+ * @param data
+ *    The first element
+ * @param stride
+ *    The distance between two consecutive elements. The SIMD kernels are used when it is 1.
+ * @param count
+ *    The number of elements
+ */
+double sumElements(const double* data, std::size_t stride, std::size_t count);
+float  sumElements(const float* data, std::size_t stride, std::size_t count);
+
+/**
+ * Position of the first maximum of count elements (see sumElements() for the parameters)
+ * @return
+ *    The position, between 0 and count - 1, or 0 if count is 0. It is unspecified if
+ *    the elements contain NaN.
+ */
+std::size_t argmaxElement(const double* data, std::size_t stride, std::size_t count);
+std::size_t argmaxElement(const float* data, std::size_t stride, std::size_t count);
+
+/// Position of the first minimum of count elements, like argmaxElement()
+std::size_t argminElement(const double* data, std::size_t stride, std::size_t count);
+std::size_t argminElement(const float* data, std::size_t stride, std::size_t count);
+
+/// @name Same as above, with the given kernel
+/// @throws std::runtime_error
+///    If the kernel is not supported by the CPU
+/// @{
+double      sumElements(ReductionKernel kernel, const double* data, std::size_t stride, std::size_t count);
+float       sumElements(ReductionKernel kernel, const float* data, std::size_t stride, std::size_t count);
+std::size_t argmaxElement(ReductionKernel kernel, const double* data, std::size_t stride, std::size_t count);
+std::size_t argmaxElement(ReductionKernel kernel, const float* data, std::size_t stride, std::size_t count);
+std::size_t argminElement(ReductionKernel kernel, const double* data, std::size_t stride, std::size_t count);
+std::size_t argminElement(ReductionKernel kernel, const float* data, std::size_t stride, std::size_t count);
+/// @}
+
+}  // namespace NdArray
+}  // namespace Euclid
+
+#endif  // ALEXANDRIA_NDARRAY_REDUCTIONKERNELS_H
@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "NdArray/ReductionKernels.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NDARRAY_X86_KERNELS
+#endif
+
+namespace Euclid {
+namespace NdArray {
+
+namespace {
+
+/// The vector kernels index the lanes with values of the element type, which are exact
+/// for floats only up to 2^24. Longer arrays are processed in chunks of this size.
+constexpr std::size_t ARG_CHUNK = std::size_t{1} << 24;
+
+template <typename T, bool Max>
+inline bool better(T a, T b) {
+  return Max ? (b < a) : (a < b);
+}
+
+/// Scalar code, which also handles the elements separated by a stride
+template <typename T>
+struct ScalarBlock {
+  static T sum(const T* data, std::size_t stride, std::size_t count) {
+    T acc{};
+    for (std::size_t i = 0; i < count; ++i) {
+      acc += data[i * stride];
+    }
+    return acc;
+  }
+
+  template <bool Max>
+  static std::size_t argBest(const T* data, std::size_t stride, std::size_t count) {
+    std::size_t best_index = 0;
+    T           best_value = count ? data[0] : T{};
+    for (std::size_t i = 1; i < count; ++i) {
+      if (better<T, Max>(data[i * stride], best_value)) {
+        best_value = data[i * stride];
+        best_index = i;
+      }
+    }
+    return best_index;
+  }
+};
+
+/**
+ * Adds the sums of consecutive blocks pairwise, as the leaves of a binary tree. The
+ * partial sums are kept in a stack, where the last two are merged as soon as they
+ * cover the same number of blocks, like the carries of a binary counter.
+ */
+template <typename T, typename Block>
+__attribute__((always_inline)) inline T pairwiseSum(const T* data, std::size_t stride, std::size_t count) {
+  T           stack[64];
+  std::size_t depth   = 0;
+  std::size_t nblocks = (count + PAIRWISE_BLOCK - 1) / PAIRWISE_BLOCK;
+  for (std::size_t b = 0; b < nblocks; ++b) {
+    std::size_t first = b * PAIRWISE_BLOCK;
+    T           s     = Block::sum(data + first * stride, stride, std::min(PAIRWISE_BLOCK, count - first));
+    for (std::size_t carry = b; carry & 1; carry >>= 1) {
+      s = stack[--depth] + s;
+    }
+    stack[depth++] = s;
+  }
+  for (; depth > 1; --depth) {
+    stack[depth - 2] += stack[depth - 1];
+  }
+  return depth ? stack[0] : T{};
+}
+
+#ifdef NDARRAY_X86_KERNELS
+
+// The vector kernels are written with the GCC vector extensions, and inlined into
+// functions compiled for each instruction set, which emit the matching instructions
+
+typedef double Double2 __attribute__((vector_size(16)));
+typedef double Double4 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+typedef float  Float4 __attribute__((vector_size(16)));
+typedef float  Float8 __attribute__((vector_size(32)));
+typedef float  Float16 __attribute__((vector_size(64)));
+
+/// Unaligned load. The vector is an output parameter, as returning it from a function
+/// compiled for the default target would change the ABI.
+template <typename V, typename T>
+__attribute__((always_inline)) inline void load(V& v, const T* data) {
+  std::memcpy(&v, data, sizeof(V));
+}
+
+/// SIMD code with the vector type V, only for contiguous elements
+template <typename T, typename V>
+struct VectorBlock {
+  static constexpr std::size_t LANES = sizeof(V) / sizeof(T);
+
+  __attribute__((always_inline)) static T sum(const T* data, std::size_t, std::size_t count) {
+    // Several accumulators, so consecutive additions do not wait for each other
+    V           acc0{}, acc1{}, acc2{}, acc3{}, v0, v1, v2, v3;
+    std::size_t i = 0;
+    for (; i + 4 * LANES <= count; i += 4 * LANES) {
+      load(v0, data + i);
+      load(v1, data + i + LANES);
+      load(v2, data + i + 2 * LANES);
+      load(v3, data + i + 3 * LANES);
+      acc0 += v0;
+      acc1 += v1;
+      acc2 += v2;
+      acc3 += v3;
+    }
+    for (; i + LANES <= count; i += LANES) {
+      load(v0, data + i);
+      acc0 += v0;
+    }
+    V acc = (acc0 + acc1) + (acc2 + acc3);
+    T s{};
+    for (std::size_t l = 0; l < LANES; ++l) {
+      s += acc[l];
+    }
+    for (; i < count; ++i) {
+      s += data[i];
+    }
+    return s;
+  }
+
+  /// Each lane keeps its best value and where it was found. The comparisons are strict,
+  /// so the first occurrence wins within a lane, and the lowest index between the lanes.
+  template <bool Max>
+  __attribute__((always_inline)) static std::size_t argBestChunk(const T* data, std::size_t count) {
+    if (count < LANES) {
+      return ScalarBlock<T>::template argBest<Max>(data, 1, count);
+    }
+    V best, index, best_index, step, v;
+    load(best, data);
+    for (std::size_t l = 0; l < LANES; ++l) {
+      index[l] = static_cast<T>(l);
+      step[l]  = static_cast<T>(LANES);
+    }
+    best_index    = index;
+    std::size_t i = LANES;
+    for (; i + LANES <= count; i += LANES) {
+      index += step;
+      load(v, data + i);
+      auto update = Max ? (v > best) : (v < best);
+      best        = update ? v : best;
+      best_index  = update ? index : best_index;
+    }
+    T           best_value = best[0];
+    std::size_t position   = static_cast<std::size_t>(best_index[0]);
+    for (std::size_t l = 1; l < LANES; ++l) {
+      auto lane_position = static_cast<std::size_t>(best_index[l]);
+      if (better<T, Max>(best[l], best_value) || (best[l] == best_value && lane_position < position)) {
+        best_value = best[l];
+        position   = lane_position;
+      }
+    }
+    for (; i < count; ++i) {
+      if (better<T, Max>(data[i], best_value)) {
+        best_value = data[i];
+        position   = i;
+      }
+    }
+    return position;
+  }
+
+  template <bool Max>
+  __attribute__((always_inline)) static std::size_t argBest(const T* data, std::size_t, std::size_t count) {
+    std::size_t position = 0;
+    for (std::size_t first = 0; first < count; first += ARG_CHUNK) {
+      std::size_t chunk_best = first + argBestChunk<Max>(data + first, std::min(ARG_CHUNK, count - first));
+      if (better<T, Max>(data[chunk_best], data[position])) {
+        position = chunk_best;
+      }
+    }
+    return position;
+  }
+};
+
+#endif
+
+/// The functions of a kernel, for contiguous elements
+struct Kernels {
+  double (*sum_double)(const double*, std::size_t);
+  float (*sum_float)(const float*, std::size_t);
+  std::size_t (*argmax_double)(const double*, std::size_t);
+  std::size_t (*argmax_float)(const float*, std::size_t);
+  std::size_t (*argmin_double)(const double*, std::size_t);
+  std::size_t (*argmin_float)(const float*, std::size_t);
+};
+
+/// Defines the functions of a kernel, with the given attributes (the target), and their table
+#define NDARRAY_REDUCTION_KERNELS(name, attributes, DoubleBlock, FloatBlock)                         \
+  attributes double sum##name(const double* data, std::size_t count) {                              \
+    return pairwiseSum<double, DoubleBlock>(data, 1, count);                                        \
+  }                                                                                                 \
+  attributes float sum##name(const float* data, std::size_t count) {                                \
+    return pairwiseSum<float, FloatBlock>(data, 1, count);                                          \
+  }                                                                                                 \
+  attributes std::size_t argmax##name(const double* data, std::size_t count) {                      \
+    return DoubleBlock::argBest<true>(data, 1, count);                                              \
+  }                                                                                                 \
+  attributes std::size_t argmax##name(const float* data, std::size_t count) {                       \
+    return FloatBlock::argBest<true>(data, 1, count);                                               \
+  }                                                                                                 \
+  attributes std::size_t argmin##name(const double* data, std::size_t count) {                      \
+    return DoubleBlock::argBest<false>(data, 1, count);                                             \
+  }                                                                                                 \
+  attributes std::size_t argmin##name(const float* data, std::size_t count) {                       \
+    return FloatBlock::argBest<false>(data, 1, count);                                              \
+  }                                                                                                 \
+  const Kernels kernels##name{sum##name, sum##name, argmax##name, argmax##name, argmin##name, argmin##name};
+
+NDARRAY_REDUCTION_KERNELS(Scalar, , ScalarBlock<double>, ScalarBlock<float>)
+
+#ifdef NDARRAY_X86_KERNELS
+using SSE2Double   = VectorBlock<double, Double2>;
+using SSE2Float    = VectorBlock<float, Float4>;
+using AVX2Double   = VectorBlock<double, Double4>;
+using AVX2Float    = VectorBlock<float, Float8>;
+using AVX512Double = VectorBlock<double, Double8>;
+using AVX512Float  = VectorBlock<float, Float16>;
+
+NDARRAY_REDUCTION_KERNELS(SSE2, __attribute__((target("sse2"))), SSE2Double, SSE2Float)
+NDARRAY_REDUCTION_KERNELS(AVX2, __attribute__((target("avx2"))), AVX2Double, AVX2Float)
+NDARRAY_REDUCTION_KERNELS(AVX512, __attribute__((target("avx512f"))), AVX512Double, AVX512Float)
+#endif
+
+#undef NDARRAY_REDUCTION_KERNELS
+
+const Kernels& kernelsOf(ReductionKernel kernel) {
+  switch (kernel) {
+#ifdef NDARRAY_X86_KERNELS
+  case ReductionKernel::SSE2:
+    return kernelsSSE2;
+  case ReductionKernel::AVX2:
+    return kernelsAVX2;
+  case ReductionKernel::AVX512:
+    return kernelsAVX512;
+#endif
+  default:
+    return kernelsScalar;
+  }
+}
+
+const Kernels& defaultKernels() {
+  static const Kernels& kernels = kernelsOf(defaultReductionKernel());
+  return kernels;
+}
+
+const Kernels& checkedKernels(ReductionKernel kernel) {
+  if (!isSupported(kernel)) {
+    throw std::runtime_error("The reduction kernel " + std::to_string(static_cast<int>(kernel)) +
+                             " is not supported by this CPU");
+  }
+  return kernelsOf(kernel);
+}
+
+}  // namespace
+
+bool isSupported(ReductionKernel kernel) {
+  switch (kernel) {
+  case ReductionKernel::Scalar:
+    return true;
+#ifdef NDARRAY_X86_KERNELS
+  case ReductionKernel::SSE2:
+    return __builtin_cpu_supports("sse2");
+  case ReductionKernel::AVX2:
+    return __builtin_cpu_supports("avx2");
+  case ReductionKernel::AVX512:
+    return __builtin_cpu_supports("avx512f");
+#endif
+  default:
+    return false;
+  }
+}
+
+ReductionKernel defaultReductionKernel() {
+  static const ReductionKernel kernel = isSupported(ReductionKernel::AVX512) ? ReductionKernel::AVX512
+                                        : isSupported(ReductionKernel::AVX2) ? ReductionKernel::AVX2
+                                        : isSupported(ReductionKernel::SSE2) ? ReductionKernel::SSE2
+                                                                             : ReductionKernel::Scalar;
+  return kernel;
+}
+
+double sumElements(const double* data, std::size_t stride, std::size_t count) {
+  if (stride != 1) {
+    return pairwiseSum<double, ScalarBlock<double>>(data, stride, count);
+  }
+  return defaultKernels().sum_double(data, count);
+}
+
+float sumElements(const float* data, std::size_t stride, std::size_t count) {
+  if (stride != 1) {
+    return pairwiseSum<float, ScalarBlock<float>>(data, stride, count);
+  }
+  return defaultKernels().sum_float(data, count);
+}
+
+std::size_t argmaxElement(const double* data, std::size_t stride, std::size_t count) {
+  if (stride != 1) {
+    return ScalarBlock<double>::argBest<true>(data, stride, count);
+  }
+  return defaultKernels().argmax_double(data, count);
+}
+
+std::size_t argmaxElement(const float* data, std::size_t stride, std::size_t count) {
+  if (stride != 1) {
+    return ScalarBlock<float>::argBest<true>(data, stride, count);
+  }
+  return defaultKernels().argmax_float(data, count);
+}
+
+std::size_t argminElement(const double* data, std::size_t stride, std::size_t count) {
+  if (stride != 1) {
+    return ScalarBlock<double>::argBest<false>(data, stride, count);
+  }
+  return defaultKernels().argmin_double(data, count);
+}
+
+std::size_t argminElement(const float* data, std::size_t stride, std::size_t count) {
+  if (stride != 1) {
+    return ScalarBlock<float>::argBest<false>(data, stride, count);
+  }
+  return defaultKernels().argmin_float(data, count);
+}
+
+double sumElements(ReductionKernel kernel, const double* data, std::size_t stride, std::size_t count) {
+  auto& kernels = checkedKernels(kernel);
+  return stride != 1 ? sumElements(data, stride, count) : kernels.sum_double(data, count);
+}
+
+float sumElements(ReductionKernel kernel, const float* data, std::size_t stride, std::size_t count) {
+  auto& kernels = checkedKernels(kernel);
+  return stride != 1 ? sumElements(data, stride, count) : kernels.sum_float(data, count);
+}
+
+std::size_t argmaxElement(ReductionKernel kernel, const double* data, std::size_t stride, std::size_t count) {
+  auto& kernels = checkedKernels(kernel);
+  return stride != 1 ? argmaxElement(data, stride, count) : kernels.argmax_double(data, count);
+}
+
+std::size_t argmaxElement(ReductionKernel kernel, const float* data, std::size_t stride, std::size_t count) {
+  auto& kernels = checkedKernels(kernel);
+  return stride != 1 ? argmaxElement(data, stride, count) : kernels.argmax_float(data, count);
+}
+
+std::size_t argminElement(ReductionKernel kernel, const double* data, std::size_t stride, std::size_t count) {
+  auto& kernels = checkedKernels(kernel);
+  return stride != 1 ? argminElement(data, stride, count) : kernels.argmin_double(data, count);
+}
+
+std::size_t argminElement(ReductionKernel kernel, const float* data, std::size_t stride, std::size_t count) {
+  auto& kernels = checkedKernels(kernel);
+  return stride != 1 ? argminElement(data, stride, count) : kernels.argmin_float(data, count);
+}
+
+}  // namespace NdArray
+}  // namespace Euclid
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file src/program/NdArrayBenchmark.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ElementsKernel/ProgramHeaders.h"
+#include "NdArray/ParallelOperations.h"
+#include <boost/program_options.hpp>
+
+using boost::program_options::options_description;
+using boost::program_options::value;
+using boost::program_options::variable_value;
+using Euclid::ThreadPool;
+using Euclid::NdArray::NdArray;
+using Euclid::NdArray::ReductionKernel;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Sum along an axis visiting the elements by their coordinates, as it was done before
+/// the stride-based reductions, kept as a reference
+NdArray<double> coordinateSum(const NdArray<double>& array, int axis) {
+  auto output_shape = array.shape();
+  auto axis_size    = output_shape[axis];
+  output_shape.erase(output_shape.begin() + axis);
+  NdArray<double> output(output_shape);
+  for (std::size_t out_i = 0; out_i < output.size(); ++out_i) {
+    auto                     out_coordinates = Euclid::NdArray::unravel_index(out_i, output_shape);
+    std::vector<std::size_t> in_coordinates(out_coordinates);
+    in_coordinates.insert(in_coordinates.begin() + axis, 0ul);
+
+    auto& output_val = output.at(out_coordinates);
+    for (std::size_t axis_i = 0; axis_i < axis_size; ++axis_i) {
+      in_coordinates[axis] = axis_i;
+      output_val += array.at(in_coordinates);
+    }
+  }
+  return output;
+}
+
+/// A value of the result of a reduction, for the checksum
+template <typename T>
+double firstValue(const NdArray<T>& result) {
+  return *result.begin();
+}
+
+double firstValue(double result) {
+  return result;
+}
+
+/// Best wall time, in milliseconds, of running the reduction the given number of times.
+/// The result is accumulated into checksum, so the call can not be optimized away.
+template <typename R>
+double timeIt(std::size_t repeat, const std::function<R()>& reduction, double& checksum) {
+  double best = 0;
+  for (std::size_t i = 0; i < repeat; ++i) {
+    auto start   = Clock::now();
+    auto result  = reduction();
+    auto elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    checksum += firstValue(result);
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+}  // namespace
+
+class NdArrayBenchmark : public Elements::Program {
+
+public:
+  options_description defineSpecificProgramOptions() override {
+    options_description options{};
+    options.add_options()("shape",
+                          value<std::vector<std::size_t>>()->multitoken()->default_value({1000, 1000, 100},
+                                                                                         "1000 1000 100"),
+                          "Shape of the benchmarked array")("repeat", value<std::size_t>()->default_value(3),
+                                                            "Number of runs per reduction, the best one is reported")(
+        "reference", value<bool>()->default_value(false),
+        "Also time the sum visiting the elements by coordinates (slow)")(
+        "threads", value<unsigned int>()->default_value(std::thread::hardware_concurrency()),
+        "Number of threads for the parallel versions, or 0 for skipping them");
+    return options;
+  }
+
+  Elements::ExitCode mainMethod(std::map<std::string, variable_value>& args) override {
+    auto shape     = args.at("shape").as<std::vector<std::size_t>>();
+    auto repeat    = args.at("repeat").as<std::size_t>();
+    auto reference = args.at("reference").as<bool>();
+    auto threads   = args.at("threads").as<unsigned int>();
+    if (shape.empty() || repeat == 0) {
+      throw std::invalid_argument("The shape and the number of runs can not be empty");
+    }
+
+    NdArray<double>                        array(shape);
+    std::mt19937                           generator{42};
+    std::uniform_real_distribution<double> distribution{0., 1.};
+    for (auto& v : array) {
+      v = distribution(generator);
+    }
+    double gigabytes = array.size() * sizeof(double) / 1e9;
+
+    std::cout << "Shape:";
+    for (auto s : shape) {
+      std::cout << ' ' << s;
+    }
+    std::cout << " (" << std::setprecision(3) << gigabytes << " GB)" << std::endl;
+    std::cout << std::setw(12) << "Function" << std::setw(6) << "Axis" << std::setw(12) << "Time ms" << std::setw(10)
+              << "GB/s" << std::endl;
+
+    double checksum = 0;
+    auto   report   = [gigabytes](const std::string& name, int axis, double ms) {
+      std::cout << std::setw(12) << name << std::setw(6) << axis << std::fixed << std::setprecision(1) << std::setw(12)
+                << ms << std::setprecision(2) << std::setw(10) << gigabytes / (ms / 1e3) << std::endl;
+    };
+
+    std::shared_ptr<ThreadPool> pool;
+    if (threads > 0) {
+      pool = std::make_shared<ThreadPool>(threads);
+    }
+    for (int axis = 0; axis < static_cast<int>(shape.size()); ++axis) {
+      using Reduction = std::function<NdArray<double>(const NdArray<double>&, int)>;
+      std::vector<std::pair<std::string, Reduction>> reductions{
+          {"sum", [](const NdArray<double>& a, int x) { return Euclid::NdArray::sum(a, x); }},
+          {"mean", [](const NdArray<double>& a, int x) { return Euclid::NdArray::mean(a, x); }},
+          {"min", [](const NdArray<double>& a, int x) { return Euclid::NdArray::min(a, x); }},
+          {"max", [](const NdArray<double>& a, int x) { return Euclid::NdArray::max(a, x); }},
+          {"var", [](const NdArray<double>& a, int x) { return Euclid::NdArray::var(a, x); }},
+          {"cumsum", [](const NdArray<double>& a, int x) { return Euclid::NdArray::cumsum(a, x); }},
+      };
+      if (reference) {
+        reductions.emplace_back("coord-sum", coordinateSum);
+      }
+      if (pool) {
+        reductions.emplace_back("par-sum", [&pool](const NdArray<double>& a, int x) {
+          return Euclid::NdArray::sum(*pool, a, x);
+        });
+        reductions.emplace_back("par-var", [&pool](const NdArray<double>& a, int x) {
+          return Euclid::NdArray::var(*pool, a, x);
+        });
+      }
+      for (auto& reduction : reductions) {
+        auto ms = timeIt<NdArray<double>>(
+            repeat, [&array, &reduction, axis]() { return reduction.second(array, axis); }, checksum);
+        report(reduction.first, axis, ms);
+      }
+      auto ms = timeIt<NdArray<std::size_t>>(
+          repeat, [&array, axis]() { return Euclid::NdArray::argmax(array, axis); }, checksum);
+      report("argmax", axis, ms);
+    }
+
+    std::cout << std::endl << "Full-array reductions (ms)" << std::endl;
+    std::cout << std::setw(12) << "Kernel" << std::setw(12) << "sum" << std::setw(12) << "argmax" << std::setw(12)
+              << "argmin" << std::endl;
+    const double* data        = &(*array.begin());
+    auto          report_full = [](const std::string& name, double sum, double argmax, double argmin) {
+      std::cout << std::setw(12) << name << std::fixed << std::setprecision(1) << std::setw(12) << sum << std::setw(12)
+                << argmax << std::setw(12) << argmin << std::endl;
+    };
+    // What the reductions did before the contiguous fast path, through the iterators
+    report_full(
+        "iterator",
+        timeIt<double>(repeat, [&array]() { return std::accumulate(array.begin(), array.end(), 0.); }, checksum),
+        timeIt<double>(
+            repeat, [&array]() { return std::max_element(array.begin(), array.end()) - array.begin(); }, checksum),
+        timeIt<double>(
+            repeat, [&array]() { return std::min_element(array.begin(), array.end()) - array.begin(); }, checksum));
+    const std::pair<const char*, ReductionKernel> kernels[] = {{"scalar", ReductionKernel::Scalar},
+                                                               {"sse2", ReductionKernel::SSE2},
+                                                               {"avx2", ReductionKernel::AVX2},
+                                                               {"avx512", ReductionKernel::AVX512}};
+    for (auto& kernel : kernels) {
+      if (!Euclid::NdArray::isSupported(kernel.second)) {
+        continue;
+      }
+      auto k = kernel.second;
+      auto n = array.size();
+      report_full(
+          kernel.first,
+          timeIt<double>(repeat, [k, data, n]() { return Euclid::NdArray::sumElements(k, data, 1, n); }, checksum),
+          timeIt<double>(
+              repeat, [k, data, n]() { return double(Euclid::NdArray::argmaxElement(k, data, 1, n)); }, checksum),
+          timeIt<double>(
+              repeat, [k, data, n]() { return double(Euclid::NdArray::argminElement(k, data, 1, n)); }, checksum));
+    }
+
+    if (pool) {
+      auto serial = timeIt<double>(
+          repeat, [&array]() { return Euclid::NdArray::sum(array); }, checksum);
+      auto parallel = timeIt<double>(
+          repeat, [&array, &pool]() { return Euclid::NdArray::sum(*pool, array); }, checksum);
+      std::cout << std::endl << "Full sum: serial " << std::setprecision(1) << serial << " ms, " << threads
+                << " threads " << parallel << " ms" << std::endl;
+    }
+
+    std::cout << "Checksum: " << checksum << std::endl;
+    return Elements::ExitCode::OK;
+  }
+};
+
+MAIN_FOR(NdArrayBenchmark)
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "NdArray/NdArray.h"
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+
+using namespace Euclid::NdArray;
+
+struct ExpressionFixture {
+  NdArray<double> a{{2, 3}, {1, 2, 3, 4, 5, 6}};
+  NdArray<double> b{{2, 3}, {6, 5, 4, 3, 2, 1}};
+  NdArray<double> c{{2, 3}, {0.5, 0.5, 0.5, 2, 2, 2}};
+};
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(NdArrayExpression_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(Arithmetic_test, ExpressionFixture) {
+  NdArray<double> result = a * b + c;
+  BOOST_CHECK_EQUAL(result.shape().size(), 2);
+  BOOST_CHECK_EQUAL(result.shape()[0], 2);
+  BOOST_CHECK_EQUAL(result.shape()[1], 3);
+  std::vector<double> expected{6.5, 10.5, 12.5, 14, 12, 8};
+  BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+
+  result   = (a - b) / c;
+  expected = {-10, -6, -2, 0.5, 1.5, 2.5};
+  BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+
+  // The operands are not modified
+  BOOST_CHECK_EQUAL(a.at(1, 2), 6);
+  BOOST_CHECK_EQUAL(b.at(1, 2), 1);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(Scalar_test, ExpressionFixture) {
+  NdArray<double> result = 2 * a - 1;
+  std::vector<double> expected{1, 3, 5, 7, 9, 11};
+  BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+
+  result   = 12. / a + -b;
+  expected = {6, 1, 0, 0, 0.4, 1};
+  for (size_t i = 0; i < expected.size(); ++i) {
+    BOOST_CHECK_CLOSE(result.begin()[i], expected[i], 1e-12);
+  }
+
+  // The type of the elements follows the usual arithmetic conversions, and is converted on assignment
+  NdArray<int>    integers{{3}, {1, 2, 3}};
+  NdArray<double> halves = integers / 2.;
+  expected = {0.5, 1, 1.5};
+  BOOST_CHECK_EQUAL_COLLECTIONS(halves.begin(), halves.end(), expected.begin(), expected.end());
+  NdArray<int> truncated = integers / 2;
+  std::vector<int> expected_int{0, 1, 1};
+  BOOST_CHECK_EQUAL_COLLECTIONS(truncated.begin(), truncated.end(), expected_int.begin(), expected_int.end());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(Functions_test, ExpressionFixture) {
+  NdArray<double> result = sqrt(a) + exp(-c) * sin(b) - pow(a, 2) + abs(-b) + log10(a * 10);
+  for (size_t i = 0; i < result.size(); ++i) {
+    double ai = a.begin()[i], bi = b.begin()[i], ci = c.begin()[i];
+    BOOST_CHECK_CLOSE(result.begin()[i],
+                      std::sqrt(ai) + std::exp(-ci) * std::sin(bi) - ai * ai + bi + std::log10(ai * 10), 1e-10);
+  }
+
+  result = pow(2., a) + pow(a, b);
+  for (size_t i = 0; i < result.size(); ++i) {
+    double ai = a.begin()[i], bi = b.begin()[i];
+    BOOST_CHECK_CLOSE(result.begin()[i], std::pow(2., ai) + std::pow(ai, bi), 1e-10);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(InPlace_test, ExpressionFixture) {
+  auto shared = a;
+  a += b * 2;
+  std::vector<double> expected{13, 12, 11, 10, 9, 8};
+  BOOST_CHECK_EQUAL_COLLECTIONS(a.begin(), a.end(), expected.begin(), expected.end());
+  // The data is modified in place, so the arrays sharing it see the change
+  BOOST_CHECK_EQUAL_COLLECTIONS(shared.begin(), shared.end(), expected.begin(), expected.end());
+
+  a -= 1;
+  a /= 2;
+  a *= b;
+  expected = {36, 27.5, 20, 13.5, 8, 3.5};
+  BOOST_CHECK_EQUAL_COLLECTIONS(a.begin(), a.end(), expected.begin(), expected.end());
+
+  a = a * a;
+  BOOST_CHECK_EQUAL(a.at(0, 0), 36 * 36);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(Strided_test) {
+  NdArray<int> m{{3, 4}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}};
+
+  // Columns are strided views, rows are contiguous
+  NdArray<int>     column = m.rslice(1) * 10 + m.rslice(3);
+  std::vector<int> expected{13, 57, 101};
+  BOOST_CHECK_EQUAL_COLLECTIONS(column.begin(), column.end(), expected.begin(), expected.end());
+
+  NdArray<int> row = m.slice(2) - m.slice(0);
+  expected         = {8, 8, 8, 8};
+  BOOST_CHECK_EQUAL_COLLECTIONS(row.begin(), row.end(), expected.begin(), expected.end());
+
+  // Writing into a view writes into the original array
+  auto second = m.rslice(2);
+  second      = m.rslice(0) + 100;
+  expected    = {0, 1, 100, 3, 4, 5, 104, 7, 8, 9, 108, 11};
+  BOOST_CHECK_EQUAL_COLLECTIONS(m.begin(), m.end(), expected.begin(), expected.end());
+
+  auto first = m.slice(0);
+  first *= 2;
+  expected = {0, 2, 200, 6, 4, 5, 104, 7, 8, 9, 108, 11};
+  BOOST_CHECK_EQUAL_COLLECTIONS(m.begin(), m.end(), expected.begin(), expected.end());
+
+  // A three dimensional array sliced on both sides
+  NdArray<double> cube{{2, 3, 4}};
+  for (size_t i = 0; i < cube.size(); ++i) {
+    cube.begin()[i] = i;
+  }
+  NdArray<double> plane = cube.rslice(3) + cube.rslice(0);
+  BOOST_CHECK_EQUAL(plane.shape().size(), 2);
+  for (size_t i = 0; i < 2; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      BOOST_CHECK_EQUAL(plane.at(i, j), cube.at(i, j, 3) + cube.at(i, j, 0));
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(ShapeMismatch_test, ExpressionFixture) {
+  NdArray<double> other{{3, 2}};
+  BOOST_CHECK_THROW(a + other, std::length_error);
+  BOOST_CHECK_THROW(a * 2 + other, std::length_error);
+  BOOST_CHECK_THROW(other = a * 2, std::length_error);
+  BOOST_CHECK_THROW(other += a, std::length_error);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//-----------------------------------------------------------------------------
@@ -17,6 +17,8 @@
  */
 
 #include "NdArray/Operations.h"
+#include <algorithm>
+#include <numeric>
 #include <boost/test/unit_test.hpp>
 
 using namespace Euclid::NdArray;
@@ -31,6 +33,88 @@ struct OpsFixture {
                                          35, 14, 25, 1,  31, 21, 29, 48, 9,  0, 51, 34, 16, 55, 53, 46, 13, 3,  22, 56}};
 };
 
+/// Applies op to the elements along the axis for each position of the output, walking
+/// the array by coordinates, as a reference for the stride-based reductions
+template <typename T, typename Op>
+std::vector<double> bruteForceAxis(const NdArray<T>& array, int axis, Op op) {
+  auto shape = array.shape();
+  if (axis < 0) {
+    axis += shape.size();
+  }
+  auto out_shape = shape;
+  out_shape.erase(out_shape.begin() + axis);
+  if (out_shape.empty()) {
+    out_shape.push_back(1);
+  }
+  std::size_t out_size = 1;
+  for (auto s : out_shape) {
+    out_size *= s;
+  }
+  std::vector<double> output;
+  for (std::size_t out_i = 0; out_i < out_size; ++out_i) {
+    auto coords = unravel_index(out_i, out_shape);
+    if (shape.size() == 1) {
+      coords.clear();
+    }
+    coords.insert(coords.begin() + axis, 0ul);
+    std::vector<double> values;
+    for (std::size_t a = 0; a < shape[axis]; ++a) {
+      coords[axis] = a;
+      values.push_back(array.at(coords));
+    }
+    output.push_back(op(values));
+  }
+  return output;
+}
+
+double meanOf(const std::vector<double>& v) {
+  return std::accumulate(v.begin(), v.end(), 0.) / v.size();
+}
+
+double varOf(const std::vector<double>& v) {
+  double m   = meanOf(v);
+  double acc = 0;
+  for (auto x : v) {
+    acc += (x - m) * (x - m);
+  }
+  return acc / v.size();
+}
+
+double minOf(const std::vector<double>& v) {
+  return *std::min_element(v.begin(), v.end());
+}
+
+double maxOf(const std::vector<double>& v) {
+  return *std::max_element(v.begin(), v.end());
+}
+
+double argmaxOf(const std::vector<double>& v) {
+  return std::max_element(v.begin(), v.end()) - v.begin();
+}
+
+template <typename T>
+void checkReductions(const NdArray<T>& array) {
+  for (int axis = -static_cast<int>(array.shape().size()); axis < static_cast<int>(array.shape().size()); ++axis) {
+    BOOST_TEST_CONTEXT("Axis " << axis) {
+      auto check = [](const std::vector<double>& expected, const NdArray<T>& result) {
+        BOOST_REQUIRE_EQUAL(result.size(), expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+          BOOST_CHECK_CLOSE(*(result.begin() + i), expected[i], 1e-4);
+        }
+      };
+      check(bruteForceAxis(array, axis, meanOf), mean(array, axis));
+      check(bruteForceAxis(array, axis, varOf), var(array, axis));
+      check(bruteForceAxis(array, axis, minOf), min(array, axis));
+      check(bruteForceAxis(array, axis, maxOf), max(array, axis));
+
+      auto expected_argmax = bruteForceAxis(array, axis, argmaxOf);
+      auto result_argmax   = argmax(array, axis);
+      BOOST_CHECK_EQUAL_COLLECTIONS(result_argmax.begin(), result_argmax.end(), expected_argmax.begin(),
+                                    expected_argmax.end());
+    }
+  }
+}
+
 //-----------------------------------------------------------------------------
 
 BOOST_AUTO_TEST_SUITE(NdArrayOps_test)
@@ -136,6 +220,23 @@ BOOST_FIXTURE_TEST_CASE(Sum1_test, OpsFixture) {
 
 //-----------------------------------------------------------------------------
 
+BOOST_FIXTURE_TEST_CASE(SumSlice_test, OpsFixture) {
+  // Non contiguous views go through the strided path
+  auto slice = three_axes.rslice(3);
+  BOOST_CHECK_EQUAL(sum(slice), std::accumulate(slice.begin(), slice.end(), 0.));
+  auto max_coords = argmax(slice);
+  auto min_coords = argmin(slice);
+  BOOST_CHECK_EQUAL(slice.at(max_coords), *std::max_element(slice.begin(), slice.end()));
+  BOOST_CHECK_EQUAL(slice.at(min_coords), *std::min_element(slice.begin(), slice.end()));
+
+  auto column = two_axes.rslice(1);
+  BOOST_CHECK_EQUAL(sum(column), 16.f);
+  BOOST_CHECK_EQUAL(argmax(column)[0], 0);
+  BOOST_CHECK_EQUAL(argmin(column)[0], 1);
+}
+
+//-----------------------------------------------------------------------------
+
 BOOST_FIXTURE_TEST_CASE(ArgMax_test, OpsFixture) {
   auto argmax1 = argmax(one_axis);
   BOOST_CHECK_EQUAL(argmax1[0], 2);
@@ -254,6 +355,96 @@ BOOST_FIXTURE_TEST_CASE(Trapz3d_test, OpsFixture) {
 
 //-----------------------------------------------------------------------------
 
+BOOST_FIXTURE_TEST_CASE(AxisReductions_test, OpsFixture) {
+  checkReductions(one_axis_float);
+  checkReductions(two_axes);
+  checkReductions(three_axes);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(AxisReductionsSlice_test, OpsFixture) {
+  // Non contiguous views
+  checkReductions(three_axes.rslice(2));
+  checkReductions(two_axes.rslice(1));
+  // Contiguous views with an offset
+  checkReductions(three_axes.slice(1));
+
+  auto sum_slice = sum(three_axes.rslice(2), 1);
+  auto expected  = bruteForceAxis(three_axes.rslice(2), 1,
+                                  [](const std::vector<double>& v) { return std::accumulate(v.begin(), v.end(), 0.); });
+  BOOST_CHECK_EQUAL_COLLECTIONS(sum_slice.begin(), sum_slice.end(), expected.begin(), expected.end());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(Mean2_test, OpsFixture) {
+  std::vector<float> expected0{23.f / 3, 16.f / 3, 14.f / 3, 25.f / 3};
+  auto               mean0 = mean(two_axes, 0);
+  BOOST_REQUIRE_EQUAL(mean0.shape().size(), 1);
+  BOOST_REQUIRE_EQUAL(mean0.shape()[0], 4);
+  BOOST_CHECK_EQUAL_COLLECTIONS(mean0.begin(), mean0.end(), expected0.begin(), expected0.end());
+
+  // Integer division
+  auto mean_int = mean(one_axis, 0);
+  BOOST_REQUIRE_EQUAL(mean_int.size(), 1);
+  BOOST_CHECK_EQUAL(mean_int.at(0), 2);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(Cumsum_test, OpsFixture) {
+  std::vector<float> expected0{7, 8, 3, 4, 12, 10, 4, 16, 23, 16, 14, 25};
+  auto               cumsum0 = cumsum(two_axes, 0);
+  BOOST_CHECK(cumsum0.shape() == two_axes.shape());
+  BOOST_CHECK_EQUAL_COLLECTIONS(cumsum0.begin(), cumsum0.end(), expected0.begin(), expected0.end());
+
+  std::vector<float> expected1{7, 15, 18, 22, 5, 7, 8, 20, 11, 17, 27, 36};
+  auto               cumsum1 = cumsum(two_axes, -1);
+  BOOST_CHECK_EQUAL_COLLECTIONS(cumsum1.begin(), cumsum1.end(), expected1.begin(), expected1.end());
+
+  std::vector<int> expected_one{1, 3, 6};
+  auto             cumsum_one = cumsum(one_axis, 0);
+  BOOST_CHECK_EQUAL_COLLECTIONS(cumsum_one.begin(), cumsum_one.end(), expected_one.begin(), expected_one.end());
+
+  // The last element along the axis is the sum
+  auto cumsum_slice = cumsum(three_axes.rslice(4), 0);
+  auto sum_slice    = sum(three_axes.rslice(4), 0);
+  for (std::size_t i = 0; i < 4; ++i) {
+    BOOST_CHECK_EQUAL(cumsum_slice.at(2, i), sum_slice.at(i));
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(ArgMaxAxis_test) {
+  NdArray<int> ties{{2, 3}, {1, 5, 5, 4, 4, 0}};
+  // The first occurrence wins
+  auto argmax0 = argmax(ties, 0);
+  BOOST_CHECK_EQUAL(argmax0.at(0), 1);
+  BOOST_CHECK_EQUAL(argmax0.at(1), 0);
+  BOOST_CHECK_EQUAL(argmax0.at(2), 0);
+  auto argmax1 = argmax(ties, 1);
+  BOOST_CHECK_EQUAL(argmax1.at(0), 1);
+  BOOST_CHECK_EQUAL(argmax1.at(1), 0);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(AxisReductionsErrors_test, OpsFixture) {
+  BOOST_CHECK_THROW(mean(two_axes, 2), std::out_of_range);
+  BOOST_CHECK_THROW(min(two_axes, -3), std::out_of_range);
+  BOOST_CHECK_THROW(cumsum(two_axes, 5), std::out_of_range);
+
+  NdArray<float> empty_axis{{3, 0}};
+  BOOST_CHECK_THROW(mean(empty_axis, 1), std::length_error);
+  BOOST_CHECK_THROW(max(empty_axis, 1), std::length_error);
+  BOOST_CHECK_THROW(argmax(empty_axis, 1), std::length_error);
+  BOOST_CHECK_EQUAL(sum(empty_axis, 1).size(), 3);
+}
+
+//-----------------------------------------------------------------------------
+
 BOOST_AUTO_TEST_SUITE_END()
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "NdArray/ParallelOperations.h"
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+
+using namespace Euclid::NdArray;
+using Euclid::ThreadPool;
+
+struct ParallelFixture {
+  ThreadPool      pool{4};
+  NdArray<double> big{{60, 50, 40}};
+  NdArray<double> big4d{{60, 50, 40, 2}};
+  NdArray<float>  small{{3, 4}, {7, 8, 3, 4, 5, 2, 1, 12, 11, 6, 10, 9}};
+
+  ParallelFixture() {
+    std::mt19937                           generator{42};
+    std::uniform_real_distribution<double> distribution{-1., 1.};
+    for (auto& v : big) {
+      v = distribution(generator);
+    }
+    for (auto& v : big4d) {
+      v = distribution(generator);
+    }
+  }
+};
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(NdArrayParallel_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(AxisReductions_test, ParallelFixture) {
+  // Each output element is computed as in the serial version, so they must be identical
+  for (int axis = -1; axis < 3; ++axis) {
+    BOOST_TEST_CONTEXT("Axis " << axis) {
+      BOOST_CHECK(sum(pool, big, axis) == sum(big, axis));
+      BOOST_CHECK(mean(pool, big, axis) == mean(big, axis));
+      BOOST_CHECK(min(pool, big, axis) == min(big, axis));
+      BOOST_CHECK(max(pool, big, axis) == max(big, axis));
+      BOOST_CHECK(var(pool, big, axis) == var(big, axis));
+      BOOST_CHECK(cumsum(pool, big, axis) == cumsum(big, axis));
+      BOOST_CHECK(argmax(pool, big, axis) == argmax(big, axis));
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(AxisReductionsSlice_test, ParallelFixture) {
+  auto slice = big4d.rslice(1);
+  for (int axis = 0; axis < 3; ++axis) {
+    BOOST_TEST_CONTEXT("Axis " << axis) {
+      BOOST_CHECK(sum(pool, slice, axis) == sum(slice, axis));
+      BOOST_CHECK(var(pool, slice, axis) == var(slice, axis));
+      BOOST_CHECK(argmax(pool, slice, axis) == argmax(slice, axis));
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(Trapz_test, ParallelFixture) {
+  std::vector<double> knots(50);
+  for (std::size_t i = 0; i < knots.size(); ++i) {
+    knots[i] = std::sqrt(i);
+  }
+  BOOST_CHECK(trapz(pool, big, knots.begin(), knots.end(), 1) == trapz(big, knots.begin(), knots.end(), 1));
+  BOOST_CHECK_THROW(trapz(pool, big, knots.begin(), knots.end(), 0), std::length_error);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(FullReductions_test, ParallelFixture) {
+  auto total = sum(pool, big);
+  BOOST_CHECK_CLOSE(total, sum(big), 1e-6);
+
+  // The blocks do not depend on the number of threads
+  for (unsigned int threads : {1u, 3u}) {
+    ThreadPool other{threads};
+    BOOST_CHECK_EQUAL(sum(other, big), total);
+  }
+
+  BOOST_CHECK(argmax(pool, big) == argmax(big));
+  BOOST_CHECK(argmin(pool, big) == argmin(big));
+  BOOST_CHECK(argmax(pool, big4d.rslice(0)) == argmax(big4d.rslice(0)));
+
+  // The first occurrence wins, also when it is on another block
+  NdArray<int> ties{{3 * PARALLEL_MIN_SIZE}};
+  ties.at(10)                        = 5;
+  ties.at(2 * PARALLEL_MIN_SIZE + 3) = 5;
+  ties.at(PARALLEL_MIN_SIZE + 1)     = -5;
+  ties.at(PARALLEL_MIN_SIZE + 2)     = -5;
+  BOOST_CHECK_EQUAL(argmax(pool, ties).front(), 10);
+  BOOST_CHECK_EQUAL(argmin(pool, ties).front(), PARALLEL_MIN_SIZE + 1);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(Small_test, ParallelFixture) {
+  // Serial fallback
+  BOOST_CHECK_EQUAL(sum(pool, small), sum(small));
+  BOOST_CHECK(sum(pool, small, 0) == sum(small, 0));
+  BOOST_CHECK(argmin(pool, small) == argmin(small));
+  BOOST_CHECK_THROW(sum(pool, small, 2), std::out_of_range);
+
+  NdArray<float> empty_axis{{3, 0}};
+  BOOST_CHECK_THROW(mean(pool, empty_axis, 1), std::length_error);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(Transform_test, ParallelFixture) {
+  auto squared = transform(pool, big, [](double v) { return v * v; });
+  BOOST_CHECK(squared.shape() == big.shape());
+  auto expected = big.begin();
+  for (auto v : squared) {
+    BOOST_CHECK_EQUAL(v, (*expected) * (*expected));
+    ++expected;
+  }
+
+  auto positive = transform(pool, big4d.rslice(1), [](double v) { return static_cast<int>(v > 0); });
+  BOOST_CHECK_EQUAL(sum(positive), std::count_if(big4d.rslice(1).begin(), big4d.rslice(1).end(),
+                                                 [](double v) { return v > 0; }));
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(Evaluate_test, ParallelFixture) {
+  NdArray<double> serial = 2 * big + exp(big);
+  NdArray<double> parallel(big.shape());
+  evaluate(pool, parallel, 2 * big + exp(big));
+  BOOST_CHECK(parallel == serial);
+
+  // Into a slice
+  auto slice = big4d.rslice(0);
+  evaluate(pool, slice, big - 1);
+  BOOST_CHECK(big4d.rslice(0) == NdArray<double>(big - 1));
+
+  NdArray<double> wrong{{2, 2}};
+  BOOST_CHECK_THROW(evaluate(pool, wrong, big + 1), std::length_error);
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -22,6 +22,7 @@
  * @author Alejandro Alvarez Ayllon
  */
 
+#include "AlexandriaKernel/Parallel.h"
 #include "NdArray/NdArray.h"
 #include <boost/test/unit_test.hpp>
 
@@ -377,6 +378,26 @@ BOOST_AUTO_TEST_CASE(RSliceTwice_test) {
 
 //-----------------------------------------------------------------------------
 
+BOOST_AUTO_TEST_CASE(ParallelIterator_test) {
+  Euclid::ThreadPool pool{4};
+  NdArray<int>       m({4, 5, 6});
+  std::iota(m.begin(), m.end(), 0);
+
+  // Iterate a view with a non unit stride
+  auto slice = m.rslice(2);
+  Euclid::parallel_for(pool, slice.begin(), slice.end(), 3, [](int& v) { v = -v; });
+  auto sum = Euclid::parallel_reduce(pool, m.begin(), m.end(), 0, 0, [](int acc, int v) { return acc + v; },
+                                     [](int a, int b) { return a + b; });
+
+  int expected = 0;
+  for (size_t i = 0; i < m.size(); ++i) {
+    expected += (i % 6 == 2) ? -static_cast<int>(i) : static_cast<int>(i);
+  }
+  BOOST_CHECK_EQUAL(sum, expected);
+}
+
+//-----------------------------------------------------------------------------
+
 BOOST_AUTO_TEST_SUITE_END()
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "NdArray/ReductionKernels.h"
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace Euclid::NdArray;
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+const ReductionKernel s_kernels[] = {ReductionKernel::Scalar, ReductionKernel::SSE2, ReductionKernel::AVX2,
+                                     ReductionKernel::AVX512};
+
+/// Values with few significant bits, so any order of summation is exact
+template <typename T>
+std::vector<T> randomValues(std::size_t count, unsigned seed) {
+  std::mt19937                    generator{seed};
+  std::uniform_int_distribution<> uniform{-64, 64};
+  std::vector<T>                  values(count);
+  for (auto& v : values) {
+    v = static_cast<T>(uniform(generator)) / 4;
+  }
+  return values;
+}
+
+template <typename T>
+void checkKernel(ReductionKernel kernel) {
+  // All the sizes up to a few blocks, so the kernels go through their remainder handling
+  for (std::size_t count = 0; count <= 3 * PAIRWISE_BLOCK + 17; ++count) {
+    BOOST_TEST_CONTEXT("Count " << count) {
+      auto values = randomValues<T>(count, count);
+      auto sum    = std::accumulate(values.begin(), values.end(), T{});
+      BOOST_CHECK_EQUAL(sumElements(kernel, values.data(), 1, count), sum);
+
+      std::size_t expected_max = std::max_element(values.begin(), values.end()) - values.begin();
+      std::size_t expected_min = std::min_element(values.begin(), values.end()) - values.begin();
+      if (count == 0) {
+        expected_max = expected_min = 0;
+      }
+      BOOST_CHECK_EQUAL(argmaxElement(kernel, values.data(), 1, count), expected_max);
+      BOOST_CHECK_EQUAL(argminElement(kernel, values.data(), 1, count), expected_min);
+
+      // Every other element
+      std::size_t half = count / 2;
+      T           strided_sum{};
+      for (std::size_t i = 0; i < half; ++i) {
+        strided_sum += values[2 * i];
+      }
+      BOOST_CHECK_EQUAL(sumElements(kernel, values.data(), 2, half), strided_sum);
+    }
+  }
+}
+
+}  // namespace
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(ReductionKernels_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(Kernels_test) {
+  BOOST_CHECK(isSupported(ReductionKernel::Scalar));
+  BOOST_CHECK(isSupported(defaultReductionKernel()));
+
+  for (auto kernel : s_kernels) {
+    if (!isSupported(kernel)) {
+      BOOST_TEST_MESSAGE("Kernel " << static_cast<int>(kernel) << " not supported, skipping");
+      BOOST_CHECK_THROW(sumElements(kernel, static_cast<const double*>(nullptr), 1, 0), std::runtime_error);
+      continue;
+    }
+    BOOST_TEST_CONTEXT("Kernel " << static_cast<int>(kernel)) {
+      checkKernel<double>(kernel);
+      checkKernel<float>(kernel);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(Ties_test) {
+  // The first occurrence wins, wherever the lanes are
+  std::vector<double> values(100, 0.);
+  values[37] = values[38] = values[99] = 5;
+  values[3] = values[64] = -5;
+  std::vector<float> float_values(values.begin(), values.end());
+
+  for (auto kernel : s_kernels) {
+    if (isSupported(kernel)) {
+      BOOST_CHECK_EQUAL(argmaxElement(kernel, values.data(), 1, values.size()), 37);
+      BOOST_CHECK_EQUAL(argminElement(kernel, values.data(), 1, values.size()), 3);
+      BOOST_CHECK_EQUAL(argmaxElement(kernel, float_values.data(), 1, float_values.size()), 37);
+      BOOST_CHECK_EQUAL(argminElement(kernel, float_values.data(), 1, float_values.size()), 3);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(LongFloat_test) {
+  // Past the positions a float can represent exactly
+  std::size_t        count = (std::size_t{1} << 24) + 1001;
+  std::vector<float> values(count, 1.f);
+  values[count - 3] = 2.f;
+  values[count - 5] = 0.f;
+
+  for (auto kernel : s_kernels) {
+    if (isSupported(kernel)) {
+      BOOST_TEST_CONTEXT("Kernel " << static_cast<int>(kernel)) {
+        BOOST_CHECK_EQUAL(argmaxElement(kernel, values.data(), 1, count), count - 3);
+        BOOST_CHECK_EQUAL(argminElement(kernel, values.data(), 1, count), count - 5);
+        // A sequential float sum stops growing at 2^24
+        BOOST_CHECK_EQUAL(sumElements(kernel, values.data(), 1, count), static_cast<float>(count));
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(Accuracy_test) {
+  // A sequential float sum of these values is off by several percent
+  std::size_t        count = 10000000;
+  std::vector<float> values(count, 0.1f);
+  double             expected         = count * static_cast<double>(0.1f);
+  double             expected_strided = (count / 3) * static_cast<double>(0.1f);
+
+  for (auto kernel : s_kernels) {
+    if (isSupported(kernel)) {
+      BOOST_TEST_CONTEXT("Kernel " << static_cast<int>(kernel)) {
+        BOOST_CHECK_CLOSE(sumElements(kernel, values.data(), 1, count), expected, 1e-3);
+        BOOST_CHECK_CLOSE(sumElements(kernel, values.data(), 3, count / 3), expected_strided, 1e-3);
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+/**
+ * @file SourceCatalog/CrossMatch.h
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#ifndef _SOURCECATALOG_CROSSMATCH_H
+#define _SOURCECATALOG_CROSSMATCH_H
+
+#include <cstddef>
+#include <vector>
+
+#include "AlexandriaKernel/ThreadPool.h"
+#include "SourceCatalog/Catalog.h"
+
+namespace Euclid {
+namespace SourceCatalog {
+
+/// A pair of sources of two catalogs found by a CrossMatch
+struct Match {
+  /// The position of the source in the first catalog
+  size_t first;
+  /// The position of the source in the second catalog
+  size_t second;
+  /// The angular separation of the two sources, in arcsec
+  double separation;
+};
+
+/**
+ * @class CrossMatch
+ * @brief Positional cross-matching of two catalogs on the sky
+ * @details
+ * The RA/Dec coordinates of the sources are projected on the unit sphere and
+ * the smaller catalog is indexed in a 3-D KdTree, where the match radius
+ * becomes the chord of the corresponding arc. The larger catalog is then
+ * processed in chunks, each one searched as a batch of parallel queries, so
+ * the memory needed besides the catalogs does not depend on its size.
+ *
+ * Sources without a Coordinates attribute never match.
+ */
+class CrossMatch {
+
+public:
+  enum class MatchMode {
+    /// For every source of the first catalog, only the closest source of the second one
+    BEST,
+    /// All the pairs of sources closer than the radius
+    ALL
+  };
+
+  /**
+   * @brief Constructor
+   * @param pool
+   *    The pool executing the queries
+   * @param chunk_size
+   *    The number of sources of the larger catalog searched at once
+   */
+  explicit CrossMatch(ThreadPool& pool, size_t chunk_size = 1 << 16);
+
+  /**
+   * @brief Finds the sources of the two catalogs closer than the given radius
+   * @param first
+   *    The first catalog
+   * @param second
+   *    The second catalog
+   * @param radius
+   *    The match radius, in arcsec
+   * @param mode
+   *    Which matches to return
+   * @return
+   *    The matches sorted by the position of the source in the first catalog,
+   *    and then by separation. Equal separations are sorted by the position in
+   *    the second catalog, so the result does not depend on the threads.
+   * @throw Elements::Exception
+   *    If the radius is not positive
+   */
+  std::vector<Match> match(const Catalog& first, const Catalog& second, double radius,
+                           MatchMode mode = MatchMode::BEST) const;
+
+private:
+  ThreadPool& m_pool;
+  size_t      m_chunk_size;
+};
+
+}  // namespace SourceCatalog
+}  // namespace Euclid
+
+#endif  // _SOURCECATALOG_CROSSMATCH_H
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+/**
+ * @file src/lib/CrossMatch.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include "SourceCatalog/CrossMatch.h"
+#include "ElementsKernel/Exception.h"
+#include "KdTree/KdTree.h"
+#include "SourceCatalog/SourceAttributes/Coordinates.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Euclid {
+namespace SourceCatalog {
+
+namespace {
+
+/// A source projected on the unit sphere
+struct SkyPoint {
+  double xyz[3];
+};
+
+}  // namespace
+
+}  // namespace SourceCatalog
+}  // namespace Euclid
+
+namespace KdTree {
+template <>
+struct KdTreeTraits<Euclid::SourceCatalog::SkyPoint> {
+  static double getCoord(const Euclid::SourceCatalog::SkyPoint& point, size_t index) {
+    return point.xyz[index];
+  }
+};
+}  // namespace KdTree
+
+namespace Euclid {
+namespace SourceCatalog {
+
+namespace {
+
+using SkyTree = KdTree::KdTree<SkyPoint, 3>;
+
+const double s_degrees_to_radians = M_PI / 180.;
+const double s_arcsec_to_radians  = s_degrees_to_radians / 3600.;
+
+/**
+ * Projects on the unit sphere the sources of the range [begin, end) which have
+ * coordinates, keeping their positions in the catalog (starting at offset)
+ */
+void project(Catalog::const_iterator begin, Catalog::const_iterator end, size_t offset,
+             std::vector<SkyTree::Coord>& points, std::vector<size_t>& positions) {
+  points.clear();
+  positions.clear();
+  for (auto source = begin; source != end; ++source, ++offset) {
+    auto coordinates = source->getAttribute<Coordinates>();
+    if (coordinates) {
+      double ra  = coordinates->getRa() * s_degrees_to_radians;
+      double dec = coordinates->getDec() * s_degrees_to_radians;
+      points.push_back({std::cos(dec) * std::cos(ra), std::cos(dec) * std::sin(ra), std::sin(dec)});
+      positions.push_back(offset);
+    }
+  }
+}
+
+/// Returns the angle between two points of the unit sphere, in arcsec, from the chord joining them
+double separation(const double* a, const double* b) {
+  double square_chord = 0;
+  for (size_t i = 0; i < 3; ++i) {
+    square_chord += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return 2 * std::asin(std::min(1., std::sqrt(square_chord) / 2)) / s_arcsec_to_radians;
+}
+
+/// Returns true if a is a better match than b for the same source of the first catalog
+bool closer(const Match& a, const Match& b) {
+  return a.separation < b.separation || (a.separation == b.separation && a.second < b.second);
+}
+
+/// Orders the matches by first source, separation and second source
+bool matchLess(const Match& a, const Match& b) {
+  return a.first < b.first || (a.first == b.first && closer(a, b));
+}
+
+}  // namespace
+
+CrossMatch::CrossMatch(ThreadPool& pool, size_t chunk_size) : m_pool(pool), m_chunk_size(std::max<size_t>(chunk_size, 1)) {}
+
+std::vector<Match> CrossMatch::match(const Catalog& first, const Catalog& second, double radius,
+                                     MatchMode mode) const {
+  if (!(radius > 0)) {
+    throw Elements::Exception() << "The cross-match radius must be positive, got " << radius;
+  }
+  double chord = 2 * std::sin(std::min(radius * s_arcsec_to_radians, M_PI) / 2);
+
+  // Index the smaller catalog and stream the larger one
+  bool           first_indexed = first.size() <= second.size();
+  const Catalog& indexed       = first_indexed ? first : second;
+  const Catalog& streamed      = first_indexed ? second : first;
+
+  std::vector<SkyTree::Coord> indexed_points;
+  std::vector<size_t>         indexed_positions;
+  project(indexed.begin(), indexed.end(), 0, indexed_points, indexed_positions);
+  std::vector<SkyPoint> tree_points;
+  tree_points.reserve(indexed_points.size());
+  for (auto& point : indexed_points) {
+    tree_points.push_back({{point.coord[0], point.coord[1], point.coord[2]}});
+  }
+  SkyTree tree{tree_points, m_pool};
+
+  std::vector<Match> matches;
+  // When the first catalog is indexed, its best matches are collected over all the chunks
+  std::vector<Match> best;
+  if (mode == MatchMode::BEST && first_indexed) {
+    best.resize(first.size(), Match{0, 0, std::numeric_limits<double>::infinity()});
+  }
+
+  std::vector<SkyTree::Coord> chunk_points;
+  std::vector<size_t>         chunk_positions;
+  for (size_t offset = 0; offset < streamed.size(); offset += m_chunk_size) {
+    size_t chunk_end = std::min(streamed.size(), offset + m_chunk_size);
+    project(streamed.begin() + offset, streamed.begin() + chunk_end, offset, chunk_points, chunk_positions);
+    auto found = tree.findPointsWithinRadius(chunk_points, chord, m_pool);
+
+    for (size_t q = 0; q < chunk_points.size(); ++q) {
+      Match closest{0, 0, std::numeric_limits<double>::infinity()};
+      for (size_t i = found.offsets[q]; i < found.offsets[q + 1]; ++i) {
+        size_t index = found.indices[i];
+        Match  m{indexed_positions[index], chunk_positions[q],
+                separation(indexed_points[index].coord, chunk_points[q].coord)};
+        if (!first_indexed) {
+          std::swap(m.first, m.second);
+        }
+        if (mode == MatchMode::ALL) {
+          matches.push_back(m);
+        } else if (first_indexed) {
+          if (closer(m, best[m.first])) {
+            best[m.first] = m;
+          }
+        } else if (closer(m, closest)) {
+          closest = m;
+        }
+      }
+      if (mode == MatchMode::BEST && !first_indexed && found.offsets[q + 1] > found.offsets[q]) {
+        matches.push_back(closest);
+      }
+    }
+  }
+
+  for (auto& m : best) {
+    if (m.separation != std::numeric_limits<double>::infinity()) {
+      matches.push_back(m);
+    }
+  }
+  std::sort(matches.begin(), matches.end(), matchLess);
+  return matches;
+}
+
+}  // namespace SourceCatalog
+}  // namespace Euclid
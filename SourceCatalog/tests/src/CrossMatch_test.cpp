@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2012-2021 Euclid Science Ground Segment
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3.0 of the License, or (at your option)
+ * any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+/**
+ * @file tests/src/CrossMatch_test.cpp
+ * @date 16/10/26
+ * @author nikoapos
+ */
+
+#include "SourceCatalog/CrossMatch.h"
+#include "SourceCatalog/SourceAttributes/Coordinates.h"
+#include <boost/test/unit_test.hpp>
+
+#include "ElementsKernel/Exception.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace Euclid::SourceCatalog;
+using Euclid::ThreadPool;
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+/// Angular separation in arcsec, with the haversine formula
+double haversine(double ra1, double dec1, double ra2, double dec2) {
+  const double to_rad = M_PI / 180.;
+  double       s_dec  = std::sin((dec2 - dec1) * to_rad / 2);
+  double       s_ra   = std::sin((ra2 - ra1) * to_rad / 2);
+  double       h      = s_dec * s_dec + std::cos(dec1 * to_rad) * std::cos(dec2 * to_rad) * s_ra * s_ra;
+  return 2 * std::asin(std::min(1., std::sqrt(h))) / to_rad * 3600.;
+}
+
+struct CrossMatchFixture {
+  std::vector<std::pair<double, double>> first_coords;
+  std::vector<std::pair<double, double>> second_coords;
+
+  // The second catalog contains displaced copies of half the sources of the
+  // first one (some of them twice), plus unrelated sources. The sources are
+  // concentrated around the RA=0 meridian and the north pole.
+  CrossMatchFixture() {
+    std::mt19937                     generator{42};
+    std::uniform_real_distribution<> uniform{-1., 1.};
+    for (int i = 0; i < 600; ++i) {
+      double ra  = (i % 2) ? std::fmod(360. + 0.05 * uniform(generator), 360.) : 180. * (1 + uniform(generator));
+      double dec = (i % 2) ? 0.05 * uniform(generator) : 89.95 + 0.05 * uniform(generator);
+      first_coords.emplace_back(ra, dec);
+    }
+    for (size_t i = 0; i < first_coords.size(); i += 2) {
+      for (int copy = 0; copy < 1 + (i % 6 == 0); ++copy) {
+        double dec = std::max(-90., std::min(90., first_coords[i].second + uniform(generator) / 3600.));
+        double ra  = std::fmod(360. + first_coords[i].first + uniform(generator) / 3600., 360.);
+        second_coords.emplace_back(ra, dec);
+      }
+    }
+    for (int i = 0; i < 200; ++i) {
+      second_coords.emplace_back(std::fmod(360. + 0.05 * uniform(generator), 360.), 0.05 * uniform(generator));
+    }
+  }
+
+  static Catalog makeCatalog(const std::vector<std::pair<double, double>>& coords, bool skip_some = false) {
+    std::vector<Source> sources;
+    for (size_t i = 0; i < coords.size(); ++i) {
+      std::vector<std::shared_ptr<Attribute>> attributes;
+      if (!skip_some || i % 7 != 3) {
+        attributes.push_back(std::make_shared<Coordinates>(coords[i].first, coords[i].second));
+      }
+      sources.emplace_back(static_cast<int64_t>(i), attributes);
+    }
+    return Catalog{sources};
+  }
+
+  std::vector<Match> bruteForce(double radius, CrossMatch::MatchMode mode, bool skip_first = false) const {
+    std::vector<Match> matches;
+    for (size_t i = 0; i < first_coords.size(); ++i) {
+      if (skip_first && i % 7 == 3) {
+        continue;
+      }
+      std::vector<Match> found;
+      for (size_t j = 0; j < second_coords.size(); ++j) {
+        double sep = haversine(first_coords[i].first, first_coords[i].second, second_coords[j].first,
+                               second_coords[j].second);
+        if (sep < radius) {
+          found.push_back(Match{i, j, sep});
+        }
+      }
+      std::sort(found.begin(), found.end(), [](const Match& a, const Match& b) {
+        return a.separation < b.separation || (a.separation == b.separation && a.second < b.second);
+      });
+      if (mode == CrossMatch::MatchMode::BEST && !found.empty()) {
+        found.resize(1);
+      }
+      matches.insert(matches.end(), found.begin(), found.end());
+    }
+    return matches;
+  }
+
+  static void check(const std::vector<Match>& matches, const std::vector<Match>& expected) {
+    BOOST_REQUIRE_EQUAL(matches.size(), expected.size());
+    for (size_t i = 0; i < matches.size(); ++i) {
+      BOOST_CHECK_EQUAL(matches[i].first, expected[i].first);
+      BOOST_CHECK_EQUAL(matches[i].second, expected[i].second);
+      BOOST_CHECK_SMALL(matches[i].separation - expected[i].separation, 1e-6);
+    }
+  }
+};
+
+}  // namespace
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE(CrossMatch_test)
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(all_test, CrossMatchFixture) {
+  ThreadPool pool{4};
+  auto       first  = makeCatalog(first_coords);
+  auto       second = makeCatalog(second_coords);
+
+  // Index the first catalog and stream the second in small chunks, and the other way round
+  CrossMatch cross_match{pool, 37};
+  auto       expected = bruteForce(1.5, CrossMatch::MatchMode::ALL);
+  BOOST_CHECK(!expected.empty());
+  check(cross_match.match(first, second, 1.5, CrossMatch::MatchMode::ALL), expected);
+
+  std::swap(first_coords, second_coords);
+  check(cross_match.match(second, first, 1.5, CrossMatch::MatchMode::ALL),
+        bruteForce(1.5, CrossMatch::MatchMode::ALL));
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(best_test, CrossMatchFixture) {
+  ThreadPool pool{4};
+  auto       first  = makeCatalog(first_coords);
+  auto       second = makeCatalog(second_coords);
+
+  CrossMatch cross_match{pool, 37};
+  auto       expected = bruteForce(1.5, CrossMatch::MatchMode::BEST);
+  check(cross_match.match(first, second, 1.5), expected);
+
+  std::swap(first_coords, second_coords);
+  check(cross_match.match(second, first, 1.5, CrossMatch::MatchMode::BEST),
+        bruteForce(1.5, CrossMatch::MatchMode::BEST));
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(missing_coordinates_test, CrossMatchFixture) {
+  ThreadPool pool{2};
+  auto       first  = makeCatalog(first_coords, true);
+  auto       second = makeCatalog(second_coords);
+
+  CrossMatch cross_match{pool};
+  check(cross_match.match(first, second, 1.5, CrossMatch::MatchMode::ALL),
+        bruteForce(1.5, CrossMatch::MatchMode::ALL, true));
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(radius_test, CrossMatchFixture) {
+  ThreadPool pool{2};
+  auto       first  = makeCatalog(first_coords);
+  auto       second = makeCatalog(second_coords);
+
+  CrossMatch cross_match{pool};
+  BOOST_CHECK_THROW(cross_match.match(first, second, 0.), Elements::Exception);
+  BOOST_CHECK_THROW(cross_match.match(first, second, -1.), Elements::Exception);
+  BOOST_CHECK(cross_match.match(first, makeCatalog({}), 1.).empty());
+}
+
+//-----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//-----------------------------------------------------------------------------